@@ -0,0 +1,341 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "rrd_interface.h"
+#include "aggregate.h"
+
+static const struct {
+  aggregate_fn fn;
+  const char *name;
+} aggregate_names[] = {
+  { agg_sum,      "sum" },
+  { agg_mean,     "mean" },
+  { agg_min,      "min" },
+  { agg_max,      "max" },
+  { agg_quantile, "quantile" },
+  { agg_band,     "band" },
+};
+
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+aggregate_fn aggregate_by_name(const std::string &name)
+{
+  for(size_t i=0; i<sizeof(aggregate_names)/sizeof(*aggregate_names); ++i)
+    if (name == aggregate_names[i].name)
+      return aggregate_names[i].fn;
+  return agg_none;
+}
+
+const char *aggregate_name(aggregate_fn fn)
+{
+  for(size_t i=0; i<sizeof(aggregate_names)/sizeof(*aggregate_names); ++i)
+    if (fn == aggregate_names[i].fn)
+      return aggregate_names[i].name;
+  return "";
+}
+
+/**
+ * @a q clamped to [0, 1], the median for NaN, as read from a file
+ */
+double valid_quantile(double q)
+{
+  if (q != q)
+    return 0.5;
+  return std::max(0.0, std::min(1.0, q));
+}
+
+/**
+ * sum or mean of the valid values in every column of @a matrix
+ *
+ * NaNs are masked instead of branched on, so the inner loop vectorizes.
+ */
+static void reduce_sum(const std::vector<double> &matrix, size_t rows, 
+      size_t n, bool mean, std::vector<double> *result)
+{
+  std::vector<double> acc(n, 0.0), cnt(n, 0.0);
+  for(size_t r=0; r<rows; ++r) {
+    const double *row = &matrix[r*n];
+    for(size_t k=0; k<n; ++k) {
+      const double v = row[k];
+      const bool valid = v == v;
+      acc[k] += valid ? v : 0.0;
+      cnt[k] += valid ? 1.0 : 0.0;
+    }
+  }
+  result->resize(n);
+  for(size_t k=0; k<n; ++k) {
+    if (cnt[k] == 0)
+      (*result)[k] = NaN;
+    else
+      (*result)[k] = mean ? acc[k] / cnt[k] : acc[k];
+  }
+}
+
+/**
+ * minimum or maximum of the valid values in every column of @a matrix
+ *
+ * comparisons with NaN are false, so NaNs never replace the accumulator
+ */
+static void reduce_minmax(const std::vector<double> &matrix, size_t rows, 
+      size_t n, bool max, std::vector<double> *result)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<double> acc(n, max ? -inf : inf);
+  for(size_t r=0; r<rows; ++r) {
+    const double *row = &matrix[r*n];
+    if (max) {
+      for(size_t k=0; k<n; ++k)
+	acc[k] = row[k] > acc[k] ? row[k] : acc[k];
+    } else {
+      for(size_t k=0; k<n; ++k)
+	acc[k] = row[k] < acc[k] ? row[k] : acc[k];
+    }
+  }
+  result->resize(n);
+  for(size_t k=0; k<n; ++k)
+    (*result)[k] = std::isinf(acc[k]) ? NaN : acc[k];
+}
+
+/**
+ * linear interpolated quantile @a q of the first @a m values of @a v,
+ * reorders @a v
+ */
+double select_quantile(double *v, size_t m, double q)
+{
+  assert(q >= 0 && q <= 1);
+  const double pos = q * (m-1);
+  const size_t lo = floor(pos);
+  std::nth_element(v, v + lo, v + m);
+  const double a = v[lo];
+  if (pos == lo || lo+1 >= m) 
+    return a;
+  const double b = *std::min_element(v + lo + 1, v + m);
+  return a + (pos - lo) * (b - a);
+}
+
+/**
+ * quantiles @a q[0..nq) of the valid values in every column of
+ * @a matrix into @a results[0..nq), @a q ascending
+ *
+ * The row-major matrix is walked in tiles of columns that fit into the
+ * cache. Every tile is transposed into a scratch buffer dropping NaNs
+ * without a branch, so each column is contiguous for the selection.
+ * Every quantile only selects above the one before.
+ */
+static void reduce_quantiles(const std::vector<double> &matrix, size_t rows,
+      size_t n, const double *q, size_t nq, std::vector<double> **results)
+{
+  const size_t tile_bytes = 256*1024;
+  const size_t tile = std::max(size_t(1), 
+	std::min(n, tile_bytes / (rows * sizeof(double))));
+
+  for(size_t j=0; j<nq; ++j)
+    results[j]->resize(n);
+  std::vector<double> scratch(tile * rows);
+  std::vector<size_t> count(tile);
+
+  for(size_t k0=0; k0<n; k0 += tile) {
+    const size_t w = std::min(tile, n - k0);
+
+    // transpose the tile, valid values to the front of each column
+    std::fill(count.begin(), count.begin() + w, 0);
+    for(size_t r=0; r<rows; ++r) {
+      const double *row = &matrix[r*n + k0];
+      for(size_t c=0; c<w; ++c) {
+	const double v = row[c];
+	scratch[c*rows + count[c]] = v;
+	count[c] += v == v;
+      }
+    }
+
+    for(size_t c=0; c<w; ++c) {
+      double *v = &scratch[c*rows];
+      const size_t m = count[c];
+      size_t left = 0;
+      for(size_t j=0; j<nq; ++j) {
+	if (!m) {
+	  (*results[j])[k0 + c] = NaN;
+	  continue;
+	}
+	// linear interpolated like select_quantile
+	assert(q[j] >= 0 && q[j] <= 1);
+	const double pos = q[j] * (m-1);
+	const size_t lo = floor(pos);
+	std::nth_element(v + left, v + lo, v + m);
+	left = lo;
+	const double a = v[lo];
+	if (pos == lo || lo+1 >= m) {
+	  (*results[j])[k0 + c] = a;
+	} else {
+	  const double b = *std::min_element(v + lo + 1, v + m);
+	  (*results[j])[k0 + c] = a + (pos - lo) * (b - a);
+	}
+      }
+    }
+  }
+}
+
+/**
+ * fetches all @a members and consolidates them onto the grid of the
+ * coarsest member, one row of @a matrix per member
+ *
+ * a cell of the grid gets the mean of the valid rows of a member that
+ * start inside it, NaN if there are none.
+ *
+ * returns the number of columns, 0 if there is no data.
+ */
+static size_t fetch_matrix(const std::vector<rrd_source> &members, 
+      time_t *start, time_t *end, unsigned long *step, const char *type,
+      std::vector<double> *matrix, int max_threads)
+{
+  std::vector<std::vector<double> > data(members.size());
+  std::vector<rrd_request> fetches(members.size());
+  for(size_t i=0; i<members.size(); ++i) {
+    fetches[i].file = members[i].file;
+    fetches[i].ds = members[i].ds;
+    fetches[i].type = type;
+    fetches[i].start = *start;
+    fetches[i].end = *end;
+    fetches[i].step = *step;
+    fetches[i].result = &data[i];
+  }
+  get_rrd_data(fetches, max_threads);
+
+  // common grid
+  unsigned long grid_step = 0;
+  time_t grid_start = 0, grid_end = 0;
+  for(std::vector<rrd_request>::const_iterator i = fetches.begin();
+      i != fetches.end(); ++i) {
+    if (i->result->empty()) continue;
+    if (grid_step == 0 || grid_start > i->start) grid_start = i->start;
+    if (grid_step == 0 || grid_end < i->end) grid_end = i->end;
+    if (grid_step < i->step) grid_step = i->step;
+  }
+  if (grid_step == 0) return 0;
+  grid_start = grid_start / grid_step * grid_step;
+  const size_t n = (grid_end - grid_start) / grid_step;
+  const size_t rows = fetches.size();
+
+  // consolidate members onto the grid, one row per member
+  matrix->assign(rows * n, NaN);
+  std::vector<unsigned> count(n);
+  for(size_t r=0; r<rows; ++r) {
+    const rrd_request &m = fetches[r];
+    std::vector<double> &m_data = data[r];
+    double *row = &(*matrix)[r*n];
+    count.assign(n, 0);
+    for(size_t i=0; i<m_data.size(); ++i) {
+      const time_t t = m.start + time_t(i * m.step);
+      if (t < grid_start || m_data[i] != m_data[i]) continue;
+      const size_t k = (t - grid_start) / grid_step;
+      if (k >= n) break;
+      row[k] = count[k]++ ? row[k] + m_data[i] : m_data[i];
+    }
+    for(size_t k=0; k<n; ++k)
+      if (count[k] > 1)
+	row[k] /= count[k];
+    std::vector<double>().swap(m_data);
+  }
+
+  *start = grid_start;
+  *end = grid_start + n * grid_step;
+  *step = grid_step;
+  return n;
+}
+
+/**
+ * gets the aggregate @a fn of all @a members from their rrds
+ *
+ * The members are fetched with up to @a max_threads concurrent
+ * fetches and consolidated onto the grid of the coarsest member. Arguments
+ * and results are like get_rrd_data, @a quantile is only used for
+ * agg_quantile, agg_band gives the median.
+ */
+void get_aggregate_data(const std::vector<rrd_source> &members, 
+      aggregate_fn fn, double quantile, 
+      time_t *start, time_t *end, unsigned long *step, const char *type,
+      std::vector<double> *result, int max_threads)
+{
+  result->clear();
+
+  std::vector<double> matrix;
+  const size_t n = fetch_matrix(members, start, end, step, type, &matrix,
+	max_threads);
+  if (!n) return;
+  const size_t rows = members.size();
+
+  switch(fn) {
+  case agg_none:
+  case agg_sum:
+    reduce_sum(matrix, rows, n, false, result);
+    break;
+  case agg_mean:
+    reduce_sum(matrix, rows, n, true, result);
+    break;
+  case agg_min:
+    reduce_minmax(matrix, rows, n, false, result);
+    break;
+  case agg_max:
+    reduce_minmax(matrix, rows, n, true, result);
+    break;
+  case agg_quantile:
+    reduce_quantiles(matrix, rows, n, &quantile, 1, &result);
+    break;
+  case agg_band: {
+    // the line of the band, the rest is in get_quantile_band
+    const double median = 0.5;
+    reduce_quantiles(matrix, rows, n, &median, 1, &result);
+    break; }
+  }
+}
+
+/**
+ * gets the band from quantile @a quantile to 1 - @a quantile of all
+ * @a members and their median
+ *
+ * like get_aggregate_data with agg_band, only the three results are
+ * kept after the reduction.
+ */
+void get_quantile_band(const std::vector<rrd_source> &members, 
+      double quantile, time_t *start, time_t *end, unsigned long *step, 
+      std::vector<double> *lo, std::vector<double> *median, 
+      std::vector<double> *hi, int max_threads)
+{
+  lo->clear();
+  median->clear();
+  hi->clear();
+
+  std::vector<double> matrix;
+  const size_t n = fetch_matrix(members, start, end, step, "AVERAGE", 
+	&matrix, max_threads);
+  if (!n) return;
+
+  const double q[] = { std::min(quantile, 1 - quantile), 0.5, 
+		       std::max(quantile, 1 - quantile) };
+  std::vector<double> *results[] = { lo, median, hi };
+  reduce_quantiles(matrix, members.size(), n, q, 3, results);
+}
@@ -0,0 +1,63 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * functions to reduce many series into one, agg_band into a band of
+ * quantiles around the median
+ */
+enum aggregate_fn { agg_none, agg_sum, agg_mean, agg_min, agg_max, 
+		    agg_quantile, agg_band };
+
+/**
+ * one datasource of a rrd-file
+ */
+struct rrd_source {
+  std::string file;
+  std::string ds;
+  rrd_source() { }
+  rrd_source(const std::string &f, const std::string &d) : file(f), ds(d) { }
+};
+
+aggregate_fn aggregate_by_name(const std::string &name);
+const char *aggregate_name(aggregate_fn fn);
+double valid_quantile(double q);
+
+double select_quantile(double *v, size_t m, double q);
+
+void get_aggregate_data(const std::vector<rrd_source> &members, 
+      aggregate_fn fn, double quantile, 
+      time_t *start, time_t *end, unsigned long *step, const char *type,
+      std::vector<double> *result, int max_threads = 0);
+
+void get_quantile_band(const std::vector<rrd_source> &members, 
+      double quantile, time_t *start, time_t *end, unsigned long *step, 
+      std::vector<double> *lo, std::vector<double> *median, 
+      std::vector<double> *hi, int max_threads = 0);
+
+#endif
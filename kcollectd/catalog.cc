@@ -0,0 +1,118 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fnmatch.h>
+
+#include <set>
+
+#include <boost/filesystem.hpp>
+
+#include "rrd_interface.h"
+#include "catalog.h"
+
+void SensorCatalog::add(const std::string &path, const QString &rrd, 
+      const QString &ds, const QString &label)
+{
+  entry e;
+  e.path = path;
+  e.rrd = rrd;
+  e.ds = ds;
+  e.label = label;
+  entries.push_back(e);
+}
+
+/**
+ * add all datasources below @a basedir, without building a tree
+ *
+ * the labels are the same the datasource-tree of the gui uses. false
+ * if @a basedir could not be read.
+ */
+bool SensorCatalog::scan(const std::string &basedir)
+{
+  using namespace boost::filesystem;
+  static const std::string delimiter("•");
+
+  try {
+    const directory_iterator end_itr;
+    for (directory_iterator host(basedir); host != end_itr; ++host ) {
+      if (!is_directory(*host)) continue;
+      for (directory_iterator sensor(*host); sensor != end_itr; ++sensor ) {
+	if (!is_directory(*sensor)) continue;
+	for (directory_iterator rrd(*sensor); rrd != end_itr; ++rrd ) {
+	  if (!is_regular(*rrd) || extension(*rrd) != ".rrd") continue;
+	  const std::string info = host->leaf() + delimiter 
+	    + sensor->leaf() + delimiter + basename(*rrd);
+	  const std::string path = host->leaf() + "/" + sensor->leaf() 
+	    + "/" + rrd->leaf();
+	  const QString file = QString::fromUtf8(rrd->string().c_str());
+	  std::set<std::string> datasources;
+	  get_dsinfo(rrd->string(), datasources);
+	  for(std::set<std::string>::const_iterator i = datasources.begin();
+	      i != datasources.end(); ++i)
+	    add(path, file, QString::fromUtf8(i->c_str()), 
+		  QString::fromUtf8((datasources.size() == 1 ? info 
+			: info + delimiter + *i).c_str()));
+	}
+      }
+    }
+  }
+  catch(basic_filesystem_error<path> &e) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * true if @a s contains shell-wildcards
+ */
+bool SensorCatalog::isPattern(const QString &s)
+{
+  return s.contains('*') || s.contains('?') || s.contains('[');
+}
+
+/**
+ * all entries matching the shell-patterns @a rrd_pattern and
+ * @a ds_pattern
+ *
+ * absolute patterns are matched against the filename, relative ones
+ * against the path below the basedir. '*' does not match '/'.
+ */
+std::vector<const SensorCatalog::entry *> 
+SensorCatalog::match(const QString &rrd_pattern, 
+      const QString &ds_pattern) const
+{
+  const QByteArray rrd_pat = rrd_pattern.toUtf8();
+  const QByteArray ds_pat = ds_pattern.toUtf8();
+  const bool absolute = rrd_pattern.startsWith('/');
+
+  std::vector<const entry *> result;
+  for(std::vector<entry>::const_iterator i = entries.begin();
+      i != entries.end(); ++i) {
+    const QByteArray file = absolute ? i->rrd.toUtf8() 
+      : QByteArray(i->path.c_str());
+    if (fnmatch(rrd_pat.data(), file.data(), FNM_PATHNAME) != 0)
+      continue;
+    if (!ds_pat.isEmpty() 
+	  && fnmatch(ds_pat.data(), i->ds.toUtf8().data(), 0) != 0)
+      continue;
+    result.push_back(&*i);
+  }
+  return result;
+}
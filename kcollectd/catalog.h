@@ -0,0 +1,60 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <string>
+#include <vector>
+
+#include <QString>
+
+/**
+ * in-memory list of all datasources found below the rrd-basedir
+ *
+ * used to expand wildcard-plots, e.g. cpu-idle.rrd of all hosts
+ */
+class SensorCatalog
+{
+public:
+  struct entry {
+    std::string path;		// relative to basedir: host/sensor/file.rrd
+    QString rrd;		// absolute filename
+    QString ds;
+    QString label;
+  };
+
+  void clear() { entries.clear(); }
+  void add(const std::string &path, const QString &rrd, const QString &ds,
+	const QString &label);
+  size_t size() const { return entries.size(); }
+  bool scan(const std::string &basedir);
+
+  std::vector<const entry *> match(const QString &rrd_pattern, 
+	const QString &ds_pattern) const;
+
+  static bool isPattern(const QString &s);
+
+private:
+  std::vector<entry> entries;
+};
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include <algorithm>
+#include <iomanip>
+
+#include "misc.h"
+#include "compress.h"
+
+namespace {
+
+inline uint64_t to_bits(double d)
+{
+  uint64_t b;
+  memcpy(&b, &d, sizeof(b));
+  return b;
+}
+
+inline double from_bits(uint64_t b)
+{
+  double d;
+  memcpy(&d, &b, sizeof(d));
+  return d;
+}
+
+/**
+ * sequential reader of the bits of a packed_series
+ */
+class bit_reader {
+ public:
+  bit_reader(const std::vector<uint64_t> &w, size_t pos) 
+    : words(&w[0]), pos_(pos) { }
+
+  // the next @a n bits, 1 <= n <= 64
+  uint64_t get(unsigned n) {
+    const size_t w = pos_ >> 6;
+    const unsigned off = pos_ & 63;
+    uint64_t r = words[w] << off;
+    if (off + n > 64)
+      r |= words[w + 1] >> (64 - off);
+    pos_ += n;
+    return r >> (64 - n);
+  }
+
+  bool bit() {
+    const bool b = (words[pos_ >> 6] >> (63 - (pos_ & 63))) & 1;
+    ++pos_;
+    return b;
+  }
+
+ private:
+  const uint64_t *words;
+  size_t pos_;
+};
+
+} // namespace
+
+const size_t packed_series::block_rows;
+
+/**
+ * append the lower @a n bits of @a value, 1 <= n <= 64
+ */
+void packed_series::put(uint64_t value, unsigned n)
+{
+  const unsigned used = bit_size & 63;
+  if (used == 0)
+    words.push_back(0);
+  const unsigned free = 64 - used;
+  if (n <= free) {
+    words.back() |= value << (free - n);
+  } else {
+    words.back() |= value >> (n - free);
+    words.push_back(value << (64 - (n - free)));
+  }
+  bit_size += n;
+}
+
+/**
+ * replace the contents by @a data
+ *
+ * Each value is XORed with the one before; equal values cost a 0-bit,
+ * others the meaningful bits of the XOR, reusing the leading and
+ * trailing zeros of the previous one when they fit.
+ */
+void packed_series::pack(const std::vector<double> &data)
+{
+  clear();
+  size_ = data.size();
+  blocks.reserve((size_ + block_rows - 1) / block_rows);
+  for(size_t first = 0; first < size_; first += block_rows) {
+    const size_t last = std::min(size_, first + block_rows);
+    blocks.push_back(bit_size);
+    uint64_t prev = to_bits(data[first]);
+    put(prev, 64);
+    unsigned lead = 65, trail = 0;	// no window yet
+    for(size_t i = first + 1; i < last; ++i) {
+      const uint64_t cur = to_bits(data[i]);
+      const uint64_t x = cur ^ prev;
+      prev = cur;
+      if (!x) {
+	put(0, 1);
+	continue;
+      }
+      const unsigned l = std::min(__builtin_clzll(x), 31);
+      const unsigned t = __builtin_ctzll(x);
+      if (l >= lead && t >= trail) {
+	put(2, 2);
+	put(x >> trail, 64 - lead - trail);
+      } else {
+	const unsigned len = 64 - l - t;
+	put(3, 2);
+	put(l, 5);
+	put(len - 1, 6);
+	put(x >> t, len);
+	lead = l;
+	trail = t;
+      }
+    }
+  }
+  std::vector<uint64_t>(words).swap(words);
+}
+
+/**
+ * decode block @a b to @a out
+ */
+void packed_series::decode(size_t b, double *out) const
+{
+  const size_t n = std::min(block_rows, size_ - b * block_rows);
+  bit_reader in(words, blocks[b]);
+  uint64_t v = in.get(64);
+  out[0] = from_bits(v);
+  unsigned lead = 0, len = 64;
+  for(size_t i = 1; i < n; ++i) {
+    if (in.bit()) {
+      if (in.bit()) {
+	lead = in.get(5);
+	len = in.get(6) + 1;
+      }
+      v ^= in.get(len) << (64 - lead - len);
+    }
+    out[i] = from_bits(v);
+  }
+}
+
+/**
+ * decode the values [@a first, @a last) to @a out, only the blocks
+ * covering them are read
+ */
+void packed_series::unpack(size_t first, size_t last, double *out) const
+{
+  last = std::min(last, size_);
+  if (first >= last)
+    return;
+
+  double buffer[block_rows];
+  for(size_t b = first / block_rows; b * block_rows < last; ++b) {
+    const size_t begin = b * block_rows;
+    const size_t end = std::min(size_, begin + block_rows);
+    if (begin >= first && end <= last) {
+      decode(b, out + (begin - first));
+    } else {
+      decode(b, buffer);
+      const size_t from = std::max(begin, first), to = std::min(end, last);
+      std::copy(buffer + (from - begin), buffer + (to - begin), 
+	    out + (from - first));
+    }
+  }
+}
+
+/**
+ * decode everything into @a data
+ */
+void packed_series::unpack(std::vector<double> &data) const
+{
+  data.resize(size_);
+  if (size_)
+    unpack(0, size_, &data[0]);
+}
+
+void packed_series::clear()
+{
+  std::vector<uint64_t>().swap(words);
+  std::vector<size_t>().swap(blocks);
+  size_ = 0;
+  bit_size = 0;
+}
+
+/**
+ * memory held by the packed values
+ */
+size_t packed_series::bytes() const
+{
+  return words.capacity() * sizeof(uint64_t) 
+    + blocks.capacity() * sizeof(size_t);
+}
+
+/**
+ * compare packing @a series with keeping them raw: compression, speed
+ * of packing, of decoding everything and of decoding single blocks in
+ * random order against copying the raw values. Returns the
+ * exit-status, 1 if a series did not decode to itself.
+ */
+int benchmark_packing(const std::vector<std::vector<double> > &series,
+      std::ostream &os)
+{
+  const double min_seconds = 0.2;	// per measurement
+  int status = 0;
+  size_t total_raw = 0, total_packed = 0;
+
+  os << "rows\traw\tpacked\tratio\tpack MB/s\tunpack MB/s"
+    "\tcopy MB/s\tblock ns\n";
+  for(size_t s=0; s<series.size(); ++s) {
+    const std::vector<double> &data = series[s];
+    if (data.empty()) continue;
+    const double mb = data.size() * sizeof(double) / 1e6;
+
+    packed_series p;
+    int rounds = 0;
+    double started = monotonic_seconds(), pack_seconds;
+    do {
+      p.pack(data);
+      ++rounds;
+    } while ((pack_seconds = monotonic_seconds() - started) < min_seconds);
+    const double pack_rate = rounds * mb / pack_seconds;
+
+    std::vector<double> out(data.size());
+    rounds = 0;
+    double unpack_seconds;
+    started = monotonic_seconds();
+    do {
+      p.unpack(0, data.size(), &out[0]);
+      ++rounds;
+    } while ((unpack_seconds = monotonic_seconds() - started) < min_seconds);
+    const double unpack_rate = rounds * mb / unpack_seconds;
+    if (memcmp(&out[0], &data[0], data.size() * sizeof(double))) {
+      os << "series " << s << " differs after unpacking\n";
+      status = 1;
+    }
+
+    rounds = 0;
+    double copy_seconds;
+    started = monotonic_seconds();
+    do {
+      std::copy(data.begin(), data.end(), out.begin());
+      ++rounds;
+    } while ((copy_seconds = monotonic_seconds() - started) < min_seconds);
+    const double copy_rate = rounds * mb / copy_seconds;
+
+    // single blocks in an order defeating prefetching
+    const size_t nblocks = (data.size() + packed_series::block_rows - 1) 
+      / packed_series::block_rows;
+    size_t decoded = 0, b = 0;
+    double block_seconds;
+    started = monotonic_seconds();
+    do {
+      b = (b + 7919) % nblocks;
+      p.unpack(b * packed_series::block_rows, 
+	    (b + 1) * packed_series::block_rows, &out[0]);
+      ++decoded;
+    } while ((block_seconds = monotonic_seconds() - started) < min_seconds);
+
+    const size_t raw = data.size() * sizeof(double);
+    total_raw += raw;
+    total_packed += p.bytes();
+    os << data.size() << '\t' << raw << '\t' << p.bytes() << '\t'
+       << std::fixed << std::setprecision(2) << double(raw) / p.bytes() 
+       << '\t' << std::setprecision(0) << pack_rate 
+       << '\t' << unpack_rate << '\t' << copy_rate 
+       << '\t' << 1e9 * block_seconds / decoded << '\n';
+  }
+  if (total_packed)
+    os << "total\t" << total_raw << '\t' << total_packed << '\t' 
+       << std::setprecision(2) << double(total_raw) / total_packed << '\n';
+  return status;
+}
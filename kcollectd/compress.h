@@ -0,0 +1,64 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdint.h>
+
+#include <iostream>
+#include <vector>
+
+/**
+ * a series of doubles compressed with the XOR-scheme of Gorilla
+ *
+ * Values are packed in blocks of block_rows, each starting with a raw
+ * value, so any range can be decoded without the blocks before it.
+ * Unknown values (NaN) repeat and cost a bit each. Decoding is bit-exact.
+ */
+class packed_series {
+ public:
+  static const size_t block_rows = 256;
+
+  packed_series() : size_(0), bit_size(0) { }
+  void pack(const std::vector<double> &data);
+  void unpack(std::vector<double> &data) const;
+  void unpack(size_t first, size_t last, double *out) const;
+  void clear();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t bytes() const;
+
+ private:
+  void put(uint64_t value, unsigned n);
+  void decode(size_t block, double *out) const;
+
+  std::vector<uint64_t> words;	// bits, most significant first
+  std::vector<size_t> blocks;	// bit-offset of each block
+  size_t size_;
+  size_t bit_size;
+};
+
+int benchmark_packing(const std::vector<std::vector<double> > &series,
+      std::ostream &os);
+
+#endif
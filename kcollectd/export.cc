@@ -0,0 +1,263 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "misc.h"
+#include "aggregate.h"
+#include "rrd_interface.h"
+#include "export.h"
+
+namespace {
+
+const int fetch_threads = 8;
+const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+/**
+ * the fetched rows of one plot, data[i] is the interval ending at
+ * start + (i+1) * step like with rrd_fetch
+ */
+struct column {
+  time_t start;
+  unsigned long step;
+  std::vector<double> data;
+
+  double at(time_t t) const {
+    if (data.empty() || t <= start) return NaN;
+    const size_t i = (t - start - 1) / step;
+    return i < data.size() ? data[i] : NaN;
+  }
+};
+
+/**
+ * number of rrd-series behind a plot
+ */
+size_t plot_width(const GraphInfo::datasource &d)
+{
+  return d.aggregate == agg_none ? 1 : d.members.size();
+}
+
+/**
+ * name of a plot in the export
+ */
+std::string plot_name(const GraphInfo::datasource &d)
+{
+  if (!d.label.isEmpty())
+    return d.label.toUtf8().data();
+  if (d.aggregate != agg_none)
+    return aggregate_name(d.aggregate);
+  return std::string(d.rrd.toUtf8().data()) + ":" + d.ds.toUtf8().data();
+}
+
+/**
+ * fetch (@a from, @a to] of all @a plots into @a cols, the plain
+ * datasources in parallel
+ */
+void fetch_chunk(const std::vector<GraphInfo::datasource> &plots,
+      time_t from, time_t to, std::vector<column> &cols)
+{
+  std::vector<rrd_request> requests;
+  std::vector<size_t> owner;
+  for(size_t i=0; i<plots.size(); ++i) {
+    const GraphInfo::datasource &d = plots[i];
+    column &c = cols[i];
+    c.start = from;
+    c.step = 1;
+    if (d.aggregate != agg_none) {
+      time_t end = to;
+      get_aggregate_data(d.members, d.aggregate, d.quantile, 
+	    &c.start, &end, &c.step, "AVERAGE", &c.data, fetch_threads);
+      continue;
+    }
+    rrd_request r;
+    r.file = d.rrd.toUtf8().data();
+    r.ds = d.ds.toUtf8().data();
+    r.type = "AVERAGE";
+    r.start = from;
+    r.end = to;
+    r.step = 1;
+    r.result = &c.data;
+    requests.push_back(r);
+    owner.push_back(i);
+  }
+  if (!requests.empty())
+    get_rrd_data(requests, fetch_threads);
+  for(size_t k=0; k<requests.size(); ++k) {
+    cols[owner[k]].start = requests[k].start;
+    cols[owner[k]].step = requests[k].step;
+  }
+}
+
+/**
+ * the csv-header, quoted where needed
+ */
+void write_csv_header(const std::vector<GraphInfo::datasource> &plots, 
+      std::ostream &os)
+{
+  os << "time";
+  for(size_t i=0; i<plots.size(); ++i) {
+    const std::string name = plot_name(plots[i]);
+    if (name.find_first_of(",\"\n") == std::string::npos) {
+      os << ',' << name;
+      continue;
+    }
+    os << ",\"";
+    for(std::string::const_iterator c = name.begin(); c != name.end(); ++c) {
+      if (*c == '"') os << '"';
+      os << *c;
+    }
+    os << '"';
+  }
+  os << '\n';
+}
+
+/**
+ * the rows (@a from, @a to] on the grid @a step as csv, empty fields
+ * for unknown values
+ */
+void write_csv_rows(const std::vector<column> &cols, time_t from, time_t to,
+      unsigned long step, std::ostream &os)
+{
+  std::string line;
+  char buffer[32];
+  for(time_t t = (from / step + 1) * step; t <= to; t += step) {
+    line.clear();
+    line.append(buffer, snprintf(buffer, sizeof(buffer), "%ld", long(t)));
+    for(size_t i=0; i<cols.size(); ++i) {
+      line += ',';
+      const double v = cols[i].at(t);
+      if (v == v)
+	line.append(buffer, format_number(v, 10, buffer));
+    }
+    line += '\n';
+    os.write(line.data(), line.size());
+  }
+}
+
+template<typename T>
+void write_raw(std::ostream &os, T value)
+{
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * header of the binary format: magic, version, byte-order mark in
+ * host order, number of columns and their names
+ */
+void write_binary_header(const std::vector<GraphInfo::datasource> &plots, 
+      std::ostream &os)
+{
+  os.write("KCEX", 4);
+  write_raw<quint32>(os, 1);
+  write_raw<quint32>(os, 0x01020304);
+  write_raw<quint32>(os, plots.size());
+  for(size_t i=0; i<plots.size(); ++i) {
+    const std::string name = plot_name(plots[i]);
+    write_raw<quint32>(os, name.size());
+    os.write(name.data(), name.size());
+  }
+}
+
+/**
+ * one block of the binary format: time of the first row, step, number
+ * of rows, then all rows of each column. A block without rows ends
+ * the file.
+ */
+void write_binary_block(const std::vector<column> &cols, time_t from, 
+      time_t to, unsigned long step, std::ostream &os)
+{
+  const time_t first = (from / step + 1) * step;
+  const quint32 rows = to < first ? 0 : (to - first) / step + 1;
+  write_raw<qint64>(os, first);
+  write_raw<quint64>(os, step);
+  write_raw<quint32>(os, rows);
+  if (!rows) return;
+
+  std::vector<double> values(rows);
+  for(size_t i=0; i<cols.size(); ++i) {
+    for(quint32 k=0; k<rows; ++k)
+      values[k] = cols[i].at(first + k * step);
+    os.write(reinterpret_cast<const char *>(&values[0]), 
+	  rows * sizeof(double));
+  }
+}
+
+} // namespace
+
+/**
+ * write the data of @a plots in (@a start, @a end] to @a os
+ *
+ * The range is fetched and written in chunks of time, sized so the
+ * rows of all plots of one chunk take about @a memory bytes. Every
+ * chunk is sampled on the finest step of its plots. Returns the
+ * exit-status.
+ */
+int export_data(const std::vector<GraphInfo::datasource> &plots, 
+      time_t start, time_t end, export_format format, size_t memory,
+      std::ostream &os)
+{
+  // rrd_fetch gives the finest step for the most recent rows
+  std::vector<column> cols(plots.size());
+  fetch_chunk(plots, end - 1, end, cols);
+  unsigned long finest = 0;
+  size_t width = 1;		// the time-column of the csv
+  for(size_t i=0; i<plots.size(); ++i) {
+    width += plot_width(plots[i]);
+    if (!cols[i].data.empty() && (finest == 0 || cols[i].step < finest))
+      finest = cols[i].step;
+  }
+  if (finest == 0)
+    finest = 1;
+  const time_t rows = std::max(size_t(1), memory / (width * sizeof(double)));
+  const time_t chunk = rows * finest;
+
+  if (format == export_csv)
+    write_csv_header(plots, os);
+  else
+    write_binary_header(plots, os);
+
+  for(time_t from = start; from < end && os; from += chunk) {
+    const time_t to = std::min(from + chunk, end);
+    fetch_chunk(plots, from, to, cols);
+
+    unsigned long step = 0;
+    for(size_t i=0; i<cols.size(); ++i)
+      if (!cols[i].data.empty() && (step == 0 || cols[i].step < step))
+	step = cols[i].step;
+    if (step == 0) 
+      continue;
+
+    if (format == export_csv)
+      write_csv_rows(cols, from, to, step, os);
+    else
+      write_binary_block(cols, from, to, step, os);
+  }
+  if (format == export_binary)
+    write_binary_block(cols, end, end, 1, os);
+
+  os.flush();
+  return os ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <time.h>
+
+#include <iostream>
+#include <vector>
+
+#include "graph.h"
+
+enum export_format { export_csv, export_binary };
+
+int export_data(const std::vector<GraphInfo::datasource> &plots, 
+      time_t start, time_t end, export_format format, size_t memory,
+      std::ostream &os);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <vector>
+
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <QSocketNotifier>
+
+#include "filewatch.h"
+#include "filewatch.moc"
+
+// quiet time after a write before reporting, and upper bound in ms
+static const int debounce_quiet = 100;
+static const int debounce_max = 1000;
+
+/**
+ *
+ */
+FileWatch::FileWatch(QObject *parent) : 
+  QObject(parent), fd(-1), notifier(0), burst(false)
+{
+#ifdef __linux__
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+  if (fd != -1) {
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+  }
+  debounce.setSingleShot(true);
+  connect(&debounce, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+/**
+ *
+ */
+FileWatch::~FileWatch()
+{
+  if (fd != -1)
+    close(fd);
+}
+
+/**
+ * watch exactly @a files, dropping watches of all others
+ *
+ * files that are replaced lose their watch and get a new one on the
+ * next call.
+ */
+void FileWatch::watch(const std::set<std::string> &files)
+{
+#ifdef __linux__
+  if (fd == -1)
+    return;
+
+  for(std::map<std::string, int>::iterator i = by_path.begin(); 
+      i != by_path.end(); ) {
+    if (files.count(i->first)) {
+      ++i;
+      continue;
+    }
+    inotify_rm_watch(fd, i->second);
+    by_wd.erase(i->second);
+    by_path.erase(i++);
+  }
+
+  for(std::set<std::string>::const_iterator i = files.begin(); 
+      i != files.end(); ++i) {
+    if (by_path.count(*i))
+      continue;
+    const int wd = inotify_add_watch(fd, i->c_str(), 
+	  IN_MODIFY | IN_CLOSE_WRITE);
+    if (wd == -1)
+      continue;
+    by_wd[wd] = *i;
+    by_path[*i] = wd;
+  }
+#endif
+}
+
+/**
+ * collect the files written and (re)start the debounce window
+ */
+void FileWatch::readEvents()
+{
+#ifdef __linux__
+  std::vector<char> buffer(4096);
+  ssize_t len;
+  bool any = false;
+  while((len = read(fd, &buffer[0], buffer.size())) > 0) {
+    for(char *p = &buffer[0]; p < &buffer[0] + len; ) {
+      const inotify_event *ev = reinterpret_cast<inotify_event *>(p);
+      p += sizeof(inotify_event) + ev->len;
+
+      std::map<int, std::string>::iterator w = by_wd.find(ev->wd);
+      if (w == by_wd.end())
+	continue;
+      if (ev->mask & IN_IGNORED) {
+	// file deleted or replaced, watch is gone
+	by_path.erase(w->second);
+	by_wd.erase(w);
+	continue;
+      }
+      changed.insert(w->second);
+      any = true;
+    }
+  }
+
+  if (!any)
+    return;
+  if (!burst) {
+    burst = true;
+    burst_start.start();
+  }
+  // stop waiting for quiet when writes never stop
+  const int left = debounce_max - burst_start.elapsed();
+  debounce.start(std::max(0, std::min(debounce_quiet, left)));
+#endif
+}
+
+/**
+ * report the collected writes
+ */
+void FileWatch::flush()
+{
+  burst = false;
+  if (!changed.empty())
+    emit filesWritten();
+  changed.clear();
+}
@@ -0,0 +1,71 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILEWATCH_H
+#define FILEWATCH_H
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <QObject>
+#include <QTime>
+#include <QTimer>
+
+class QSocketNotifier;
+
+/**
+ * watches a set of files with inotify and reports writes to them
+ *
+ * writes are collected for a short debounce window, so the burst of
+ * writes collectd does every interval results in one filesWritten().
+ * Without inotify isWatching() is false and nothing is reported.
+ */
+class FileWatch : public QObject
+{
+  Q_OBJECT;
+public:
+  explicit FileWatch(QObject *parent=0);
+  virtual ~FileWatch();
+
+  void watch(const std::set<std::string> &files);
+  bool isWatching() const { return !by_path.empty(); }
+  const std::set<std::string> &written() const { return changed; }
+
+signals:
+  void filesWritten();
+
+private slots:
+  void readEvents();
+  void flush();
+
+private:
+  int fd;
+  QSocketNotifier *notifier;
+  std::map<int, std::string> by_wd;
+  std::map<std::string, int> by_path;
+  std::set<std::string> changed;
+  QTimer debounce;
+  bool burst;			// debounce running since burst_start
+  QTime burst_start;
+};
+
+#endif
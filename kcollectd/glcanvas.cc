@@ -0,0 +1,258 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "graph.h"
+#include "glcanvas.h"
+#include "glcanvas.moc"
+
+/**
+ *
+ */
+GLCanvas::GLCanvas(QWidget *parent) : 
+  QGLWidget(QGLFormat(QGL::SampleBuffers), parent), 
+  vbo(QGLBuffer::VertexBuffer), uploaded(false), 
+  background_tex(0), background_changed(false)
+{
+  setAttribute(Qt::WA_TransparentForMouseEvents);
+  setAutoFillBackground(false);
+}
+
+/**
+ *
+ */
+GLCanvas::~GLCanvas()
+{
+  makeCurrent();
+  if (background_tex)
+    deleteTexture(background_tex);
+  vbo.destroy();
+}
+
+/**
+ * start collecting the panels of a new frame
+ *
+ * with @a rebuild all vertices are thrown away, else only panels not
+ * seen before are built and the others keep their vertices.
+ */
+void GLCanvas::beginFrame(bool rebuild)
+{
+  if (rebuild) {
+    panels.clear();
+    vertices.clear();
+    uploaded = false;
+  }
+  for(std::vector<panel>::iterator i = panels.begin(); i != panels.end(); ++i)
+    i->visible = false;
+}
+
+/**
+ * set geometry and y-range of panel @a n and build its vertices if
+ * necessary. Returns the number of vertices drawn for this panel.
+ */
+size_t GLCanvas::addPanel(size_t n, const QRect &rect, double min, double max,
+      const GraphInfo &ginfo, const QColor *band, const QColor *line)
+{
+  if (n >= panels.size())
+    panels.resize(n + 1);
+  panel &p = panels[n];
+  p.visible = true;
+  p.rect = rect;
+  p.min = min;
+  p.max = max;
+  if (p.built)
+    return p.vertices;
+
+  // large counters keep their precision relative to the panel
+  p.offset = min;
+  const size_t first_vertex = vertices.size() / 2;
+  int color_nr = 0;
+  for(GraphInfo::const_iterator gi = ginfo.begin(); gi != ginfo.end(); ++gi) {
+    const std::vector<double> &min_data = gi->min_data;
+    const std::vector<double> &max_data = gi->max_data;
+    const std::vector<double> &avg_data = gi->avg_data;
+    const int color = color_nr++ % 8;
+
+    series s;
+    s.band_color = band[color];
+    s.line_color = line[color];
+
+    // bands as triangle-strips of (min, max)-pairs
+    s.band_size = std::min(min_data.size(), max_data.size());
+    for(int i=0; i<s.band_size; ++i) {
+      while (i<s.band_size && (isnan(min_data[i]) || isnan(max_data[i]))) ++i;
+      const int first = vertices.size() / 2;
+      for(; i<s.band_size && !isnan(min_data[i]) && !isnan(max_data[i]); ++i) {
+	vertices.push_back(i);
+	vertices.push_back(min_data[i] - p.offset);
+	vertices.push_back(i);
+	vertices.push_back(max_data[i] - p.offset);
+      }
+      if (int(vertices.size() / 2) > first)
+	s.band.push_back(std::make_pair(first, int(vertices.size() / 2) - first));
+    }
+
+    // averages as line-strips
+    s.line_size = avg_data.size();
+    for(int i=0; i<s.line_size; ++i) {
+      while (i<s.line_size && isnan(avg_data[i])) ++i;
+      const int first = vertices.size() / 2;
+      for(; i<s.line_size && !isnan(avg_data[i]); ++i) {
+	vertices.push_back(i);
+	vertices.push_back(avg_data[i] - p.offset);
+      }
+      if (int(vertices.size() / 2) > first)
+	s.line.push_back(std::make_pair(first, int(vertices.size() / 2) - first));
+    }
+    p.series_list.push_back(s);
+  }
+  p.vertices = vertices.size() / 2 - first_vertex;
+  p.built = true;
+  uploaded = false;
+  return p.vertices;
+}
+
+/**
+ * set grid, labels and legends to draw below the graphs
+ */
+void GLCanvas::setBackground(const QPixmap &pixmap)
+{
+  background = pixmap;
+  background_changed = true;
+  update();
+}
+
+/**
+ *
+ */
+void GLCanvas::initializeGL()
+{
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+  vbo.setUsagePattern(QGLBuffer::StaticDraw);
+  vbo.create();
+}
+
+/**
+ * map sample-index and value of a series with @a size samples into
+ * the rect of panel @a p, the values are stored less p.offset
+ */
+void GLCanvas::transform(const panel &p, int size) const
+{
+  const QRect &r = p.rect;
+  const double xm = size > 1 ? double(r.right() - r.left()) / (size - 1) : 0;
+  const double ym = (r.top() - r.bottom()) / (p.max - p.min);
+  glLoadIdentity();
+  // pixel-centers, as QPainter draws them
+  glTranslated(r.left() + 0.5, r.bottom() + 0.5 - (p.min - p.offset) * ym, 0);
+  glScaled(xm, ym, 1);
+}
+
+/**
+ *
+ */
+void GLCanvas::paintGL()
+{
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(0, width(), height(), 0, -1, 1);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+
+  // grid, labels and legends
+  if (background_changed) {
+    if (background_tex)
+      deleteTexture(background_tex);
+    background_tex = background.isNull() ? 0 : bindTexture(background);
+    background_changed = false;
+  }
+  if (background_tex) {
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, background_tex);
+    glColor4ub(255, 255, 255, 255);
+    // bindTexture() flips the image, texture-row 0 is the bottom
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 1); glVertex2i(0, 0);
+    glTexCoord2f(1, 1); glVertex2i(background.width(), 0);
+    glTexCoord2f(1, 0); glVertex2i(background.width(), background.height());
+    glTexCoord2f(0, 0); glVertex2i(0, background.height());
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+  } else {
+    glClearColor(1, 1, 1, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+
+  if (vertices.empty())
+    return;
+
+  // samples, uploaded once per change of data
+  const GLvoid *base = 0;
+  if (vbo.isCreated()) {
+    vbo.bind();
+    if (!uploaded) {
+      vbo.allocate(&vertices[0], vertices.size() * sizeof(GLfloat));
+      uploaded = true;
+    }
+  } else {
+    // no buffer-objects, draw from client-memory
+    base = &vertices[0];
+  }
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, base);
+
+  glEnable(GL_SCISSOR_TEST);
+  for(std::vector<panel>::const_iterator p = panels.begin(); 
+      p != panels.end(); ++p) {
+    if (!p->visible)
+      continue;
+    glScissor(p->rect.left(), height() - p->rect.bottom() - 1, 
+	  p->rect.width(), p->rect.height());
+
+    // all bands first, so no band covers a line
+    std::vector<series>::const_iterator s;
+    for(s = p->series_list.begin(); s != p->series_list.end(); ++s) {
+      transform(*p, s->band_size);
+      glColor4ub(s->band_color.red(), s->band_color.green(), 
+	    s->band_color.blue(), s->band_color.alpha());
+      for(run_list::const_iterator r = s->band.begin(); r != s->band.end(); ++r)
+	glDrawArrays(GL_TRIANGLE_STRIP, r->first, r->second);
+    }
+    glEnable(GL_LINE_SMOOTH);
+    for(s = p->series_list.begin(); s != p->series_list.end(); ++s) {
+      transform(*p, s->line_size);
+      glColor4ub(s->line_color.red(), s->line_color.green(), 
+	    s->line_color.blue(), s->line_color.alpha());
+      for(run_list::const_iterator r = s->line.begin(); r != s->line.end(); ++r)
+	glDrawArrays(GL_LINE_STRIP, r->first, r->second);
+    }
+    glDisable(GL_LINE_SMOOTH);
+  }
+  glDisable(GL_SCISSOR_TEST);
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  if (vbo.isCreated())
+    vbo.release();
+}
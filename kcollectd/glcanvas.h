@@ -0,0 +1,92 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GLCANVAS_H
+#define GLCANVAS_H
+
+#include <utility>
+#include <vector>
+
+#include <QColor>
+#include <QGLBuffer>
+#include <QGLWidget>
+#include <QPixmap>
+#include <QRect>
+
+class GraphInfo;
+
+/**
+ * draws the min/max-bands and lines of all panels with OpenGL on top
+ * of the offscreen-pixmap holding grid, labels and legends
+ *
+ * the samples are uploaded into one vertex-buffer when the data
+ * changes, a new y-range or a resize only changes the transformation.
+ * The widget is transparent for mouse-events, so the Graph below
+ * still gets them.
+ */
+class GLCanvas : public QGLWidget
+{
+  Q_OBJECT;
+public:
+  explicit GLCanvas(QWidget *parent=0);
+  virtual ~GLCanvas();
+
+  void beginFrame(bool rebuild);
+  size_t addPanel(size_t n, const QRect &rect, double min, double max, 
+	const GraphInfo &ginfo, const QColor *band, const QColor *line);
+  void setBackground(const QPixmap &pixmap);
+
+protected:
+  virtual void initializeGL();
+  virtual void paintGL();
+
+private:
+  typedef std::vector<std::pair<int, int> > run_list; // first, count
+
+  struct series {
+    int band_size, line_size;	// number of samples
+    run_list band, line;
+    QColor band_color, line_color;
+  };
+  struct panel {
+    bool built, visible;
+    QRect rect;
+    double min, max;
+    double offset;		// subtracted from the values before float
+    size_t vertices;
+    std::vector<series> series_list;
+    panel() : built(false), visible(false), min(0), max(0), offset(0), 
+	      vertices(0) { }
+  };
+
+  void transform(const panel &p, int size) const;
+
+  std::vector<panel> panels;
+  std::vector<GLfloat> vertices;
+  QGLBuffer vbo;
+  bool uploaded;
+
+  QPixmap background;
+  GLuint background_tex;
+  bool background_changed;
+};
+
+#endif
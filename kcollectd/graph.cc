@@ -22,22 +22,51 @@
 #include <time.h>
 
 #include <vector>
+#include <set>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <limits>
 
+#include <QAtomicInt>
+#include <QFontDatabase>
 #include <QPainter>
 #include <QPolygon>
 #include <QRect>
+#include <QRunnable>
 
 #include <KLocale>
 #include <KGlobalSettings>
 #include <KIcon>
 #include <KMenu>
 
+#include "../config.h"
 #include "rrd_interface.h"
+#include "catalog.h"
 #include "misc.h"
 #include "timeaxis.h"
+#include "replay.h"
+#include "trace.h"
+#include "raster.h"
+#include "session.h"
+#include "memory.h"
+#ifdef HAVE_OPENGL
+#include "glcanvas.h"
+#endif
 #include "graph.moc"
 
+/**
+ * renders one panel of a Graph on a worker-thread
+ */
+class PanelJob : public QRunnable {
+  Graph *graph;
+  int n;
+public:
+  PanelJob(Graph *g, int i) : graph(g), n(i) { }
+  virtual void run() { graph->drawPanel(n); }
+};
+
 // some magic numbers
 
 // colors
@@ -57,6 +86,75 @@ static const double header_font_mag = 1.2;
 // distance between elements
 const int marg = 2; 
 
+// maximum number of concurrent rrd-fetches
+static const int fetch_threads = 8;
+
+// views at least this long show the coarsest RRA first and refine it
+static const time_t progressive_span = 3600*24*7;
+
+// requests per batch of a refinement, it can be cancelled between them
+static const size_t refine_batch = 3*fetch_threads;
+
+// wildcard-expansions added per step, and delay between steps in ms
+static const int expand_batch = 32;
+static const int expand_delay = 50;
+
+// interval for taking live-values from the LiveFeed in ms
+static const int live_interval = 250;
+
+// time collectd may take to write after a step boundary in seconds
+static const double write_delay = 1.0;
+
+/**
+ * fetches one refinement pass of a Graph on a worker-thread and hands
+ * the results back to the GUI-thread with Graph::refineDone()
+ */
+class RefineJob : public QRunnable {
+public:
+  Graph *graph;
+  int pass;
+  time_t start, span;		// view the pass was started for
+  std::vector<rrd_request> requests;
+  std::vector<std::vector<double> > results;
+  // graph and plot of each three requests
+  std::vector<std::pair<size_t, size_t> > targets;
+  QAtomicInt cancelled, finished;
+
+  RefineJob(Graph *g, int p, time_t s, time_t l) 
+    : graph(g), pass(p), start(s), span(l), cancelled(0), finished(0) {
+    setAutoDelete(false);
+  }
+  virtual void run();
+};
+
+void RefineJob::run()
+{
+  for(size_t k = 0; k < requests.size() && !cancelled; k += refine_batch) {
+    const size_t last = std::min(k + refine_batch, requests.size());
+    std::vector<rrd_request> batch(requests.begin() + k, 
+	  requests.begin() + last);
+    get_rrd_data(batch, fetch_threads);
+    std::copy(batch.begin(), batch.end(), requests.begin() + k);
+  }
+  finished = 1;
+  QMetaObject::invokeMethod(graph, "refineDone", Qt::QueuedConnection);
+}
+
+// aggregates offered in the context-menu
+static const struct aggregate_entry {
+  const char *label;
+  aggregate_fn fn;
+  double quantile;
+} aggregate_entries[] = {
+  { I18N_NOOP("sum"),             agg_sum,      0 },
+  { I18N_NOOP("mean"),            agg_mean,     0 },
+  { I18N_NOOP("minimum"),         agg_min,      0 },
+  { I18N_NOOP("maximum"),         agg_max,      0 },
+  { I18N_NOOP("median"),          agg_quantile, 0.5 },
+  { I18N_NOOP("95th percentile"), agg_quantile, 0.95 },
+  { I18N_NOOP("5th to 95th percentile band"), agg_band, 0.05 },
+};
+
 inline double norm(const QPointF &a)
 {
   return sqrt(a.x()*a.x() + a.y()*a.y());
@@ -99,7 +197,7 @@ void drawArrow(QPainter &p, const QPoint &first,  const QPoint &second)
  *
  */
 Graph::Graph(QWidget *parent) :
-  QFrame(parent), data_is_valid(false), 
+  QFrame(parent), data_is_valid(false), data_is_stale(false), last_write(0),
   start(time(0)-3600*24), span(3600*24), step(1), dragging(false),
   font(KGlobalSettings::generalFont()), 
   small_font(KGlobalSettings::smallestReadableFont()),
@@ -108,19 +206,37 @@ Graph::Graph(QWidget *parent) :
   //color_major(255, 180, 180), color_minor(220, 220, 220), 
   //color_graph_bg(255, 255, 255),
   //color_minmax(180, 255, 180, 200), color_line(0, 170, 0),
-  autoUpdateTimer(-1)
+  autoUpdateTimer(-1), suspended_(false), pack_suspended(false), 
+  update_interval(10000), effective_interval(10000),
+  last_tick(0),
+  recorder_(0), clock_(0), fetch_count(0), perf_overlay(false), 
+  gl_canvas(0), gl_dirty(true), legend_stats(true), stats_width(0), 
+  time_shift(0), crosshair_(true), hovering(false), hover_pending(false), 
+  hover_pos(-1, -1), antialias_(true),
+  session(0), live_feed(0)
 {
   setFrameStyle(QFrame::StyledPanel|QFrame::Plain);
   setMinimumWidth(300);
   setMinimumHeight(150);
   setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
   setAcceptDrops(true);
+  setMouseTracking(true);
+  connect(&expand_timer, SIGNAL(timeout()), this, SLOT(expandStep()));
+  connect(&decode_timer, SIGNAL(timeout()), this, SLOT(decodeStep()));
+  connect(&live_timer, SIGNAL(timeout()), this, SLOT(drainLive()));
+  align_timer.setSingleShot(true);
+  grid.key_interval = -1;
+  connect(&align_timer, SIGNAL(timeout()), this, SLOT(tick()));
+  connect(&file_watch, SIGNAL(filesWritten()), this, SLOT(filesWritten()));
+  refine_pool.setMaxThreadCount(1);
   
   // setup color-tables
   for (int i=0; i<8; ++i) {
     color_line[i].setRgb(colortable[i][0], colortable[i][1], colortable[i][2]);
     color_minmax[i].setRgb(0.5*colortable[i][0], 0.5*colortable[i][1], 
 	  0.5*colortable[i][2], 160);
+    color_shift[i].setRgb(colortable[i][0], colortable[i][1], 
+	  colortable[i][2], 110);
   }
 
   // idiotic case-differentiation on point or pixelsize necessary :(
@@ -136,55 +252,568 @@ Graph::Graph(QWidget *parent) :
   tz_off = tz.tz_minuteswest * 60;
 }
 
+Graph::~Graph()
+{
+  cancelRefine();
+  refine_pool.waitForDone();
+  for(std::deque<RefineJob *>::iterator i = refine_jobs.begin(); 
+      i != refine_jobs.end(); ++i)
+    delete *i;
+  delete session;
+  delete recorder_;
+}
+
+/**
+ * record the view-operations into @a r from now on, the graph takes
+ * ownership of @a r, 0 stops recording
+ *
+ * the recording starts with the view shown now.
+ */
+void Graph::recorder(ViewRecorder *r)
+{
+  delete recorder_;
+  recorder_ = r;
+  if (recorder_) recorder_->record("view", start, span);
+}
+
+/**
+ * mtime of the file(s) behind a datasource
+ */
+static double source_mtime(const GraphInfo::datasource &d)
+{
+  if (d.aggregate == agg_none)
+    return get_rrd_mtime(d.rrd.toUtf8().data());
+
+  double mtime = 0;
+  for(std::vector<rrd_source>::const_iterator i = d.members.begin(); 
+      i != d.members.end(); ++i)
+    mtime = std::max(mtime, get_rrd_mtime(i->file));
+  return mtime;
+}
+
+/**
+ * requests for min, max and average of the plain rrd-series @a d
+ */
+static void add_requests(const GraphInfo::datasource &d, time_t start, 
+      time_t end, unsigned long step, std::vector<double> *min, 
+      std::vector<double> *max, std::vector<double> *avg, 
+      std::vector<rrd_request> &requests)
+{
+  rrd_request r;
+  r.file = d.rrd.toUtf8().data();
+  r.ds = d.ds.toUtf8().data();
+  r.start = start;
+  r.end = end;
+  r.step = step;
+  r.type = "MIN";
+  r.result = min;
+  requests.push_back(r);
+  r.type = "MAX";
+  r.result = max;
+  requests.push_back(r);
+  r.type = "AVERAGE";
+  r.result = avg;
+  requests.push_back(r);
+}
+
+/**
+ * move @a data @a n steps to the left, filling up with NaN
+ */
+static void shift_series(std::vector<double> &data, size_t n)
+{
+  const size_t size = data.size();
+  data.erase(data.begin(), data.begin() + std::min(n, size));
+  data.resize(size, std::numeric_limits<double>::quiet_NaN());
+}
+
+/**
+ * rows [first, last) of @a dst, starting at @a start with @a step,
+ * from @a src fetched from @a src_start with @a src_step
+ */
+static void place_rows(const std::vector<double> &src, time_t src_start, 
+      unsigned long src_step, std::vector<double> &dst, time_t start, 
+      unsigned long step, size_t first, size_t last)
+{
+  for(size_t i = first; i < last; ++i) {
+    const time_t t = start + (i + 1) * step;
+    const size_t k = t > src_start ? (t - src_start - 1) / src_step : size_t(-1);
+    dst[i] = k < src.size() ? src[k] : std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
 /** 
  * get average, min and max data
  *
  * set start end to the values get_rrd_data returns
  * don't change span, because it can shrink
+ *
+ * after a change of the view everything is fetched, else only
+ * datasources added since the last fetch.  When auto-update moved
+ * the view, only files written since the last fetch are read, the
+ * data of the others is shifted.
+ *
+ * With @a progressive a new view of plain rrd-series spanning at
+ * least progressive_span is first read from the coarsest RRA, finer
+ * passes follow on a worker-thread.
  */
-bool Graph::fetchAllData ()
+bool Graph::fetchAllData (bool progressive)
 {
-  if (data_is_valid)
-    return (true);
-  
   if (empty())
     return (false);
 
+  const bool all = !data_is_valid;
+  const bool follow = data_is_valid && data_is_stale;
+  std::vector<GraphInfo::datasource *> unchanged, requested;
+  std::vector<rrd_request> requests;
+  bool fetched = false;
+
+  // the snapshot of a session-file stands in for its time-range
+  const bool from_snapshot = session && session->hasData()
+    && start == session->start() && span == session->span();
+  if (all) {
+    pending_decode.clear();
+    cancelRefine();
+  }
+  bool coarse = progressive && all && !from_snapshot 
+    && span >= progressive_span;
+  for(graph_list::const_iterator i = begin(); coarse && i != end(); ++i)
+    for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j)
+      if (j->aggregate != agg_none)
+	coarse = false;
+  if (from_snapshot) {
+    data_start = session->dataStart();
+    data_end = session->dataEnd();
+    step = session->step();
+  }
   for(graph_list::iterator i = begin(); i != end(); ++i) {
     for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j) {
-      const std::string file(j->rrd.toUtf8().data());
-      const std::string ds(j->ds.toUtf8().data());    
-      
-      data_start = start;
-      data_end = start + span;
-      step = 1;
-      get_rrd_data (file, ds, &data_start, &data_end, &step, 
-	    "MIN", &j->min_data);
-      
-      data_start = start;
-      data_end = start + span;
-      step = 1;
-      get_rrd_data (file, ds, &data_start, &data_end, &step, 
-	    "MAX", &j->max_data);
-      
-      data_start = start;
-      data_end = start + span;
-      step = 1;
-      get_rrd_data (file, ds, &data_start, &data_end, &step,
-	    "AVERAGE", &j->avg_data);
+      if (!all && !follow && j->fetched) {
+	++frame_stats.cache_hits;
+	continue;
+      }
+      if (from_snapshot && j->snapshot >= 0) {
+	// the first panel at once, the others after it is drawn
+	j->fetched = true;
+	++j->generation;
+	gl_dirty = true;
+	j->rows_start = data_start;
+	j->rows_step = step;
+	if (i == begin()) {
+	  session->series(j->snapshot, &*j);
+	} else {
+	  j->avg_data.clear();
+	  j->min_data.clear();
+	  j->max_data.clear();
+	  pending_decode.push_back(std::make_pair(size_t(i - begin()), 
+		    size_t(j - i->begin())));
+	}
+	continue;
+      }
+      const double mtime = source_mtime(*j);
+      if (follow && j->fetched && mtime == j->mtime) {
+	unchanged.push_back(&*j);
+	++frame_stats.cache_hits;
+	continue;
+      }
+      j->fetched = true;
+      ++j->generation;
+      gl_dirty = true;
+      j->mtime = mtime;
+      last_write = std::max(last_write, mtime);
+
+      if (j->aggregate != agg_none) {
+	data_start = start;
+	data_end = start + span;
+	step = 1;
+	if (j->aggregate == agg_band) {
+	  get_quantile_band(j->members, j->quantile, 
+		&data_start, &data_end, &step, 
+		&j->min_data, &j->avg_data, &j->max_data, fetch_threads);
+	} else {
+	  get_aggregate_data(j->members, j->aggregate, j->quantile,
+		&data_start, &data_end, &step, "AVERAGE", &j->avg_data,
+		fetch_threads);
+	  j->min_data.clear();
+	  j->max_data.clear();
+	}
+	j->rows_start = data_start;
+	j->rows_step = step;
+	fetched = true;
+	fetch_count += j->members.size();
+	frame_stats.rows += j->avg_data.size();
+	continue;
+      }
+
+      // a step of the whole span selects the coarsest RRA
+      add_requests(*j, start, start + span, coarse ? span : 1, 
+	    &j->min_data, &j->max_data, &j->avg_data, requests);
+      requested.push_back(&*j);
     }    
   }
+
+  if (!requests.empty()) {
+    get_rrd_data(requests, fetch_threads);
+    for(size_t k = 0; k < requested.size(); ++k) {
+      requested[k]->rows_start = requests[3*k+2].start;
+      requested[k]->rows_step = requests[3*k+2].step;
+    }
+    fetched = true;
+    for(std::vector<rrd_request>::const_iterator r = requests.begin();
+	r != requests.end(); ++r)
+      frame_stats.rows += r->result->size();
+    fetch_count += requests.size();
+    data_start = requests.back().start;
+    data_end = requests.back().end;
+    step = requests.back().step;
+    if (coarse)
+      startRefine(1);
+  }
   data_is_valid = true;
+  data_is_stale = false;
+  if (!pending_decode.empty())
+    decode_timer.start(0);
+
+  // data of unchanged files only has to move to the new start, on the
+  // grid of its own step as rrd_fetch would align it
+  bool refetch = false;
+  for(std::vector<GraphInfo::datasource *>::iterator i = unchanged.begin();
+      i != unchanged.end(); ++i) {
+    const unsigned long s = (*i)->rows_step;
+    const time_t aligned = s ? start - start % s : 0;
+    if (s && aligned >= (*i)->rows_start 
+	  && (aligned - (*i)->rows_start) % s == 0) {
+      const size_t n = (aligned - (*i)->rows_start) / s;
+      if (n) {
+	shift_series((*i)->avg_data, n);
+	shift_series((*i)->min_data, n);
+	shift_series((*i)->max_data, n);
+	(*i)->rows_start = aligned;
+	++(*i)->generation;
+	gl_dirty = true;
+      }
+    } else {
+      (*i)->fetched = false;
+      refetch = true;
+    }
+  }
+  if (refetch)
+    fetchAllData();
+  else if (!fetched && !unchanged.empty() && step) {
+    // nothing read, the view still follows the shifted rows
+    const time_t moved = start - start % step - data_start;
+    data_start += moved;
+    data_end += moved;
+  }
 
   return (true);
 }
 
+/**
+ * bring the overlay of the series time_shift earlier up to the view
+ *
+ * Every series is shifted on the grid of its own rows. Rows before
+ * its rows_start are history: they are fetched once and, when
+ * auto-update moves the view, shifted like the live data so only the
+ * new rows are fetched. Rows of the overlay inside the view are taken
+ * from avg_data instead of being fetched again.
+ */
+void Graph::fetchShifted()
+{
+  if (!time_shift || !data_is_valid)
+    return;
+
+  std::vector<rrd_request> requests;
+  std::vector<std::vector<double> > results;
+  std::vector<std::pair<GraphInfo::datasource *, size_t> > targets;
+  for(graph_list::iterator i = begin(); i != end(); ++i) {
+    for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j) {
+      const unsigned long s = j->rows_step ? j->rows_step : step;
+      const time_t shifted 
+	= (j->rows_step ? j->rows_start : data_start) - time_shift;
+      const size_t n = j->avg_data.size();
+      const size_t hist = std::min(n, size_t(time_shift / s));
+      size_t keep = 0;
+      if (j->shift_step == s && j->shift_data.size() == n 
+	    && shifted >= j->shift_start 
+	    && (shifted - j->shift_start) % s == 0) {
+	const size_t k = (shifted - j->shift_start) / s;
+	if (k) {
+	  shift_series(j->shift_data, k);
+	  j->shift_source = j->generation - 1;
+	}
+	keep = hist > k ? hist - k : 0;
+      } else {
+	j->shift_data.assign(n, std::numeric_limits<double>::quiet_NaN());
+	j->shift_source = j->generation - 1;
+      }
+      j->shift_start = shifted;
+      j->shift_step = s;
+      if (keep == hist) {
+	++frame_stats.cache_hits;
+	continue;
+      }
+
+      // the missing history
+      ++j->shift_generation;
+      gl_dirty = true;
+      if (j->aggregate != agg_none) {
+	time_t from = shifted + keep * s, to = shifted + hist * s;
+	unsigned long agg_step = 1;
+	std::vector<double> data;
+	get_aggregate_data(j->members, j->aggregate, j->quantile,
+	      &from, &to, &agg_step, "AVERAGE", &data, fetch_threads);
+	place_rows(data, from, agg_step, j->shift_data, shifted, s, keep, hist);
+	fetch_count += j->members.size();
+	frame_stats.rows += data.size();
+	continue;
+      }
+      rrd_request r;
+      r.file = j->rrd.toUtf8().data();
+      r.ds = j->ds.toUtf8().data();
+      r.type = "AVERAGE";
+      r.start = shifted + keep * s;
+      r.end = shifted + hist * s;
+      r.step = 1;
+      requests.push_back(r);
+      targets.push_back(std::make_pair(&*j, keep));
+    }
+  }
+
+  if (!requests.empty()) {
+    results.resize(requests.size());
+    for(size_t k=0; k<requests.size(); ++k)
+      requests[k].result = &results[k];
+    get_rrd_data(requests, fetch_threads);
+    fetch_count += requests.size();
+    for(size_t k=0; k<requests.size(); ++k) {
+      GraphInfo::datasource &d = *targets[k].first;
+      const size_t hist = std::min(d.avg_data.size(), 
+	    size_t(time_shift / d.shift_step));
+      place_rows(results[k], requests[k].start, requests[k].step, 
+	    d.shift_data, d.shift_start, d.shift_step, targets[k].second, hist);
+      frame_stats.rows += results[k].size();
+    }
+  }
+
+  // the rest overlaps the view
+  for(graph_list::iterator i = begin(); i != end(); ++i)
+    for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j)
+      if (j->shift_source != j->generation) {
+	const size_t n = j->avg_data.size();
+	place_rows(j->avg_data, j->shift_start + time_shift, j->shift_step, 
+	      j->shift_data, j->shift_start, j->shift_step,
+	      std::min(n, size_t(time_shift / j->shift_step)), n);
+	j->shift_source = j->generation;
+	++j->shift_generation;
+	gl_dirty = true;
+      }
+}
+
+/**
+ * show the series again @a offset seconds earlier, 0 switches the
+ * overlay off
+ */
+void Graph::timeShift(time_t offset)
+{
+  time_shift = std::max(time_t(0), offset);
+  for(graph_list::iterator i = begin(); i != end(); ++i)
+    for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j) {
+      j->shift_data.clear();
+      j->shift_step = 0;
+      ++j->shift_generation;
+    }
+  changed_state = true;
+  layout();
+  update();
+}
+
+/**
+ * legend-text of the statistics of a series
+ */
+static QString stats_text(const series_stats &s)
+{
+  if (!s.count)
+    return i18n("no data");
+
+  // one unit for all values
+  std::string SI;
+  double mag;
+  si_char(std::max(fabs(s.min), fabs(s.max)), SI, mag);
+  return i18n("min %1  avg %2  max %3  p95 %4  last %5",
+	QString::fromUtf8(si_number(s.min, 3, SI, mag).c_str()),
+	QString::fromUtf8(si_number(s.avg, 3, SI, mag).c_str()),
+	QString::fromUtf8(si_number(s.max, 3, SI, mag).c_str()),
+	QString::fromUtf8(si_number(s.p95, 3, SI, mag).c_str()),
+	QString::fromUtf8(si_number(s.last, 3, SI, mag).c_str()));
+}
+
+/**
+ * bring the legend-statistics up to the fetched data, each series on
+ * the grid of its own rows
+ */
+void Graph::updateStats()
+{
+  for(graph_list::iterator i = begin(); i != end(); ++i)
+    for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j)
+      if (j->stats.generation != j->generation) {
+	j->stats.update(j->avg_data, j->min_data, j->max_data, 
+	      j->rows_start, j->rows_step ? j->rows_step : step);
+	j->stats.generation = j->generation;
+	j->stats_label = stats_text(j->stats);
+      }
+}
+
+/**
+ * show the graphs of @a s on its time-range with its data, takes
+ * ownership of @a s
+ */
+void Graph::snapshot(SessionFile *s)
+{
+  delete session;
+  session = s;
+  pending_decode.clear();
+  start = s->start();
+  span = s->span();
+  data_is_valid = false;
+  layout();
+  update();
+}
+
+/**
+ * decode the snapshot-series of the next panel
+ */
+void Graph::decodeStep()
+{
+  if (session && !pending_decode.empty()) {
+    const size_t g = pending_decode.front().first;
+    while (!pending_decode.empty() && pending_decode.front().first == g) {
+      const size_t p = pending_decode.front().second;
+      pending_decode.pop_front();
+      if (g < glist.size() && p < glist[g].size()) {
+	GraphInfo::datasource &d = *(glist[g].begin() + p);
+	if (session->series(d.snapshot, &d))
+	  ++d.generation;
+      }
+    }
+  }
+  if (pending_decode.empty())
+    decode_timer.stop();
+  gl_dirty = true;
+  update();
+}
+
+/**
+ * fetch the current view finer on a worker-thread. Pass 1 asks for
+ * about a row per pixel, pass 2 for the finest RRA; passes that can
+ * not beat the step already shown are skipped.
+ */
+void Graph::startRefine(int pass)
+{
+  unsigned long wanted = 0;
+  for(; pass <= 2; ++pass) {
+    wanted = pass == 1 
+      ? std::max(1UL, (unsigned long)(span / std::max(1, graph_rect.width())))
+      : 1;
+    if (wanted < step)
+      break;
+  }
+  size_t n = 0;
+  for(graph_list::const_iterator i = begin(); i != end(); ++i)
+    n += i->size();
+  if (pass > 2 || !n)
+    return;
+
+  RefineJob *job = new RefineJob(this, pass, start, span);
+  job->results.resize(3*n);
+  for(graph_list::const_iterator i = begin(); i != end(); ++i)
+    for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j) {
+      const size_t k = 3*job->targets.size();
+      job->targets.push_back(std::make_pair(size_t(i - begin()), 
+		size_t(j - i->begin())));
+      add_requests(*j, start, start + span, wanted, &job->results[k], 
+	    &job->results[k+1], &job->results[k+2], job->requests);
+    }
+  refine_jobs.push_back(job);
+  refine_pool.start(job);
+}
+
+/**
+ * drop all refinements, a running one stops after its batch.
+ * Returns true if there were any.
+ */
+bool Graph::cancelRefine()
+{
+  for(std::deque<RefineJob *>::iterator i = refine_jobs.begin(); 
+      i != refine_jobs.end(); ++i)
+    (*i)->cancelled = 1;
+  return !refine_jobs.empty();
+}
+
+/**
+ * take the series of finished refinements if they are finer than the
+ * shown ones and the view is still the same, then go on to the next
+ * pass
+ */
+void Graph::refineDone()
+{
+  while (!refine_jobs.empty() && refine_jobs.front()->finished) {
+    RefineJob *job = refine_jobs.front();
+    refine_jobs.pop_front();
+    if (job->cancelled || !data_is_valid || job->requests.empty()) {
+      delete job;
+      continue;
+    }
+    if (job->start != start || job->span != span) {
+      // auto-update moved the view, try again for the new one
+      startRefine(job->pass);
+      delete job;
+      continue;
+    }
+
+    const rrd_request &last = job->requests.back();
+    if (last.step < step) {
+      for(size_t t = 0; t < job->targets.size(); ++t) {
+	const size_t g = job->targets[t].first, p = job->targets[t].second;
+	if (g >= glist.size() || p >= glist[g].size())
+	  continue;
+	GraphInfo::datasource &d = *(glist[g].begin() + p);
+	if (job->requests[3*t].file != d.rrd.toUtf8().data() 
+	      || job->requests[3*t].ds != d.ds.toUtf8().data())
+	  continue;
+	d.min_data.swap(job->results[3*t]);
+	d.max_data.swap(job->results[3*t+1]);
+	d.avg_data.swap(job->results[3*t+2]);
+	d.rows_start = job->requests[3*t+2].start;
+	d.rows_step = job->requests[3*t+2].step;
+	++d.generation;
+      }
+      data_start = last.start;
+      data_end = last.end;
+      step = last.step;
+      fetch_count += job->requests.size();
+      gl_dirty = true;
+      update();
+      emit dataFetched();
+    }
+    startRefine(job->pass + 1);
+    delete job;
+  }
+}
+
 /**
  * 
  */
 void Graph::clear()
 {
   glist.clear();
+  pending.clear();
+  expand_timer.stop();
+  delete session;
+  session = 0;
+  pending_decode.clear();
+  decode_timer.stop();
+  align_timer.stop();
+  cancelRefine();
   data_is_valid = false;
   layout();
   update();
@@ -194,6 +823,12 @@ int Graph::calcLegendHeights(int box_size, int width)
 {
   const QFontMetrics &fontmetric = fontMetrics();
 
+  // fixed, so the legend does not change its layout on every update
+  const QString sample("-8.88 M");
+  stats_width = fontmetric.width(
+	i18n("min %1  avg %2  max %3  p95 %4  last %5", 
+	      sample, sample, sample, sample, sample));
+
   int total_legend_height = 0;
   for(graph_list::iterator i = begin(); i != end(); ++i) {
 
@@ -204,7 +839,8 @@ int Graph::calcLegendHeights(int box_size, int width)
 
     std::vector<int> label_width;
     for(GraphInfo::const_iterator gi = i->begin(); gi != i->end(); ++gi)
-      label_width.push_back(fontmetric.width(gi->label) + box_size + marg);
+      label_width.push_back(fontmetric.width(gi->label) + box_size + marg 
+	    + (legend_stats ? stats_width + 2*marg : 0));
     
     const int n = label_width.size();
     int r;
@@ -244,6 +880,10 @@ void Graph::drawLegend(QPainter &paint, int left, int y,
       paint.drawText(cx + box_size + marg, cy, i->label);
       
       int w = box_size + marg + fontmetric.width(i->label);
+      if (legend_stats) {
+	paint.drawText(cx + w + 2*marg, cy, i->stats_label);
+	w += 2*marg + stats_width;
+      }
       if (w>max_width) 
 	max_width = w;
       cy += fontmetric.lineSpacing();
@@ -279,11 +919,36 @@ void Graph::drawHeader(QPainter &paint)
   QString buffer_to = Qstrftime(format.toAscii(), localtime(&data_end));
   QString label = QString(i18n("from %1 to %2"))
     .arg(buffer_from) .arg(buffer_to);
+  if (time_shift && time_shift % (3600*24*7) == 0)
+    label += i18np(", dimmed one week earlier", ", dimmed %1 weeks earlier", 
+	  int(time_shift / (3600*24*7)));
+  else if (time_shift && time_shift % (3600*24) == 0)
+    label += i18np(", dimmed one day earlier", ", dimmed %1 days earlier", 
+	  int(time_shift / (3600*24)));
+  else if (time_shift && time_shift % 3600 == 0)
+    label += i18np(", dimmed one hour earlier", ", dimmed %1 hours earlier",
+	  int(time_shift / 3600));
+  else if (time_shift && time_shift % 60 == 0)
+    label += i18np(", dimmed one minute earlier", 
+	  ", dimmed %1 minutes earlier", int(time_shift / 60));
+  else if (time_shift)
+    label += i18np(", dimmed one second earlier", 
+	  ", dimmed %1 seconds earlier", int(time_shift));
   int x = (contentsRect().left()+contentsRect().right())/2
     - fontmetric.width(label)/2;
   int y = fontmetric.ascent() + marg;
   paint.drawText(x, y, label);
 
+  // counters of the previous frame, this one is not finished yet
+  if (perf_overlay) {
+    paint.setFont(small_font);
+    const QString stats = last_stats.toString();
+    QRect box = paint.fontMetrics().boundingRect(stats);
+    box.moveTopRight(QPoint(contentsRect().right() - marg, marg));
+    paint.fillRect(box, QColor(255, 255, 255, 200));
+    paint.drawText(box, Qt::AlignLeft, stats);
+  }
+
   paint.restore();
 }
 
@@ -340,38 +1005,83 @@ void Graph::drawXLines(QPainter &paint, const QRect &rect,
   paint.restore();
 }
 
-void Graph::drawXLabel(QPainter &paint, int y, int left, int right, 
-      time_iterator i, QString format, bool center)
+/**
+ * recompute the x-labels of the current grid if the axis changed
+ *
+ * all panels share the x-axis, so this is done once per frame and the
+ * labels only get drawn in the panels.
+ */
+void Graph::updateXLabels()
 {
+  const int left = graph_rect.left(), right = graph_rect.right();
+  time_iterator i = grid.label;
+  if (grid.key_interval == i.interval() 
+	&& grid.key_start == data_start && grid.key_end == data_end 
+	&& grid.key_left == left && grid.key_right == right 
+	&& grid.key_first == *i
+	&& grid.key_center == grid.center && grid.key_format == grid.format)
+    return;
+  grid.key_start = data_start;
+  grid.key_end = data_end;
+  grid.key_left = left;
+  grid.key_right = right;
+  grid.key_first = *i;
+  grid.key_interval = i.interval();
+  grid.key_center = grid.center;
+  grid.key_format = grid.format;
+
+  grid.labels.clear();
   if (!i.valid()) return;
-  paint.save();
-  paint.setFont(small_font);
 
   // setting up linear mappings
   const linMap xmap(data_start, left, data_end, right);
+  const QFontMetrics fontmetric(small_font);
 
-  // draw labels
-  paint.setPen(palette().windowText().color());
-  if (center) --i;
+  if (grid.center) --i;
   for(; *i <= data_end; ++i) {
     // special handling for localtime/mktime on DST
-    time_t t = center ? *i + i.interval() / 2 : *i;
-    tm tm;
-    localtime_r(&t, &tm);
-    QString label = Qstrftime(i18n(format.toAscii()).toAscii(), &tm);
+    const time_t t = grid.center ? *i + i.interval() / 2 : *i;
+    const QString &label = time_labels(grid.format, t);
     if(! label.isNull()) {
-      const int width = paint.fontMetrics().width(label);
-      int x = center 
-	? xmap(*i + i.interval() / 2) - width / 2
-	: xmap(*i) - width / 2;
-	  
-      if (x > left && x + width < right)
-	paint.drawText(x, y, label);
+      const int width = fontmetric.width(label);
+      const int x = xmap(t) - width / 2;
+      if (x > left && x + width < right) {
+	tick_label l = { QPoint(x, 0), label };
+	grid.labels.push_back(l);
+      }
     }
   }
+}
+
+void Graph::drawXLabel(QPainter &paint, int y)
+{
+  paint.save();
+  paint.setFont(small_font);
+  paint.setPen(label_color);
+  for(std::vector<tick_label>::const_iterator i = grid.labels.begin(); 
+      i != grid.labels.end(); ++i)
+    paint.drawText(i->pos.x(), y, i->text);
   paint.restore();
 }
 
+/**
+ * width of a label formatted with @a format, -1 if it can not be
+ * formatted. Only the first call per format does the formatting.
+ */
+int Graph::sampleWidth(const char *format)
+{
+  std::map<const char *, int>::const_iterator i = sample_widths.find(format);
+  if (i != sample_widths.end())
+    return i->second;
+
+  const time_t now = time(0);
+  tm tm;
+  localtime_r(&now, &tm);
+  const QString label = Qstrftime(format, &tm);
+  const int width = label.isNull() ? -1 : QFontMetrics(font).width(label);
+  return sample_widths[format] = width;
+}
+
 void Graph::findXGrid(int width, QString &format, bool &center,
       time_iterator &minor_x, time_iterator &major_x, time_iterator &label_x)
 {
@@ -411,15 +1121,13 @@ void Graph::findXGrid(int width, QString &format, bool &center,
     {     0,       0,      0, 0,                    true,  align_tzalign },
   };
 
-  const QFontMetrics fontmetric(font);
   const time_t time_span = data_end - data_start;
-  const time_t now = time(0);
 
   for(int i=0; axis_params[i].maxspan; ++i) {
     if (time_span < axis_params[i].maxspan) {
-      QString label = Qstrftime(axis_params[i].format, localtime(&now));
-      if(!label.isNull()) {
-	const int textwidth = fontmetric.width(label) 
+      const int samplewidth = sampleWidth(axis_params[i].format);
+      if(samplewidth >= 0) {
+	const int textwidth = samplewidth
 	  * time_span / axis_params[i].major * 3 / 2;
 	if (textwidth < width) {
 	  switch(axis_params[i].align) {
@@ -450,9 +1158,9 @@ void Graph::findXGrid(int width, QString &format, bool &center,
       }
     }
   }
-  QString label = Qstrftime("%Y", localtime(&now));
-  if(!label.isNull()) {
-    const int textwidth = fontmetric.width(label) * 3 / 2;
+  const int samplewidth = sampleWidth("%Y");
+  if(samplewidth >= 0) {
+    const int textwidth = samplewidth * 3 / 2;
     // fixed-point calculation with 16 bit fraction.
     int num = (time_span * textwidth * 16) / ( year * width);
     if (num < 16 ) {
@@ -472,36 +1180,59 @@ void Graph::findXGrid(int width, QString &format, bool &center,
 }
 
 void Graph::drawYLabel(QPainter &paint, const QRect &rect, 
-      const Range &y_range, double base)
+      const Range &y_range, double base, panel_buffers &buf)
 {
-  // setting up linear mappings
-  const linMap ymap(y_range.min(), rect.bottom(), y_range.max(), rect.top());
-
-  const QFontMetrics fontmetric(font);
+  // labels are only formatted if the axis changed
+  if (buf.ylabel_rect != rect || buf.ylabel_base != base
+	|| buf.ylabel_range.min() != y_range.min() 
+	|| buf.ylabel_range.max() != y_range.max()) {
+    buf.ylabel_rect = rect;
+    buf.ylabel_base = base;
+    buf.ylabel_range = y_range;
+    buf.ylabels.clear();
 
-  // SI Unit for nice display
-  std::string SI;
-  double mag;
-  si_char(y_range.max(), SI, mag);
-
-  // make sure labels don not overlap
-  const int fontheight = fontmetric.height();
-  while(rect.height() < fontheight * (y_range.max()-y_range.min())/base) 
-    if (rect.height() > fontheight * (y_range.max()-y_range.min())/base/2)
-      base *= 2;
-    else if (rect.height() > fontheight * (y_range.max()-y_range.min())/base/5)
-      base *= 5;
-    else
-      base *= 10;
+    // setting up linear mappings
+    const linMap ymap(y_range.min(), rect.bottom(), y_range.max(), rect.top());
+
+    const QFontMetrics fontmetric(font);
+
+    // SI Unit for nice display
+    std::string SI;
+    double mag;
+    si_char(y_range.max(), SI, mag);
+
+    // make sure labels don not overlap
+    const int fontheight = fontmetric.height();
+    while(rect.height() < fontheight * (y_range.max()-y_range.min())/base) 
+      if (rect.height() > fontheight * (y_range.max()-y_range.min())/base/2)
+	base *= 2;
+      else if (rect.height() > fontheight * (y_range.max()-y_range.min())/base/5)
+	base *= 5;
+      else
+	base *= 10;
+
+    // format labels
+    char text[64];
+    double min = ceil(y_range.min()/base)*base;
+    double max = floor(y_range.max()/base)*base;
+    for(double i = min; i <= max; i += base) {
+      int len = format_number(i/mag, 6, text);
+      if (!SI.empty()) {
+	text[len++] = ' ';
+	strcpy(text + len, SI.c_str());
+      }
+      tick_label l;
+      l.text = QString(text);
+      l.pos = QPoint(rect.left() - fontmetric.width(l.text) - 4, 
+	    ymap(i) + fontmetric.ascent()/2);
+      buf.ylabels.push_back(l);
+    }
+  }
 
   // draw labels
-  double min = ceil(y_range.min()/base)*base;
-  double max = floor(y_range.max()/base)*base;
-  for(double i = min; i <= max; i += base) {
-    const std::string label = si_number(i, 6, SI, mag);
-    const int x = rect.left() - fontmetric.width(label.c_str()) - 4;
-    paint.drawText(x,  ymap(i) + fontmetric.ascent()/2, label.c_str());
-  }
+  for(std::vector<tick_label>::const_iterator i = buf.ylabels.begin(); 
+      i != buf.ylabels.end(); ++i)
+    paint.drawText(i->pos, i->text);
 }
 
 void Graph::drawYLines(QPainter &paint, const QRect &rect, 
@@ -538,163 +1269,361 @@ void Graph::drawYLines(QPainter &paint, const QRect &rect,
  * draw the graph itself
  */
 void Graph::drawGraph(QPainter &paint, const QRect &rect, 
-      const GraphInfo &ginfo, double min, double max)
+      const GraphInfo &ginfo, double min, double max, panel_buffers &buf)
 {
-  const linMap ymap(min, rect.bottom(), max, rect.top());
-  // define once use many
-  QPolygon points;
-  
   paint.save();
   //paint.setRenderHint(QPainter::Antialiasing);
 
   // draw all min/max backshadows
   int color_nr = 0;
   for(GraphInfo::const_iterator gi = ginfo.begin(); gi != ginfo.end(); ++gi) {
-    const std::vector<double> &min_data = gi->min_data;
-    const std::vector<double> &max_data = gi->max_data;
-
-    if (min_data.empty() || max_data.empty())
-      continue;
-    const int size = gi->min_data.size();
-
-    // setting up linear mappings
-    const linMap xmap(0, rect.left(), size-1, rect.right());
-   
-    if (!min_data.empty() && !max_data.empty()) {  
-      paint.setPen(Qt::NoPen);
-      paint.setBrush(QBrush(color_minmax[color_nr++ % 8]));
-      for(int i=0; i<size; ++i) {
-	while (i<size && (isnan(min_data[i]) || isnan(max_data[i]))) ++i;
-	int l = i;
-	while (i<size && !isnan(min_data[i]) && !isnan(max_data[i])) ++i;
-	const int asize = i-l;
-	points.resize(asize*2);
-	int k;
-	for(k=0; k<asize; ++k, ++l) {
-	  points.setPoint(k, xmap(l), ymap(min_data[l]));
-	}
-	--l;
-	for(; k<2*asize; ++k, --l) {
-	  points.setPoint(k, xmap(l), ymap(max_data[l]));
-	}
-	paint.drawPolygon(points);
+    const int color = color_nr++ % 8;
+    screen_series &s = gi->band_screen;
+    map_band(gi->min_data, gi->max_data, gi->generation, 
+	  rect.width(), rect.height(), min, max, &s);
+
+    paint.setPen(Qt::NoPen);
+    paint.setBrush(QBrush(color_minmax[color]));
+    for(int k=0; k<s.count(); ++k) {
+      // lower edge forwards, upper edge backwards
+      const int asize = s.runs[k+1] - s.runs[k];
+      if (buf.polygon.size() < 2*asize)
+	buf.polygon.resize(2*asize);
+      for(int l = s.runs[k], p = 0; p < asize; ++l, ++p) {
+	const int x = rect.left() + int(s.x[l]);
+	buf.polygon[p] = QPoint(x, rect.top() + int(s.lo[l]));
+	buf.polygon[2*asize-1-p] = QPoint(x, rect.top() + int(s.hi[l]));
       }
+      paint.drawPolygon(buf.polygon.constData(), 2*asize);
+      buf.stats.points += 2*asize;
     }
   }
 
   // draw all averages
   color_nr = 0;
   for(GraphInfo::const_iterator gi = ginfo.begin(); gi != ginfo.end(); ++gi) {
-    const std::vector<double> &avg_data = gi->avg_data;
-
-    if (avg_data.empty()) continue;
-    const int size = avg_data.size();
-    
-    // setting up linear mappings
-    const linMap xmap(0, rect.left(), size-1, rect.right());
-   
-    // draw ing
-    if (!avg_data.empty()) {
-      paint.setPen(color_line[color_nr++ % 8]);
-      for(int i=0; i<size; ++i) {
-	while (i<size && isnan(avg_data[i])) ++i;
-	int l = i;
-	while (i<size && !isnan(avg_data[i])) ++i;
-	const int asize = i-l;
-	points.resize(asize);
-	for(int k=0; k<asize; ++k, ++l) {
-	  points.setPoint(k, xmap(l), ymap(avg_data[l]));
-	}
-	paint.drawPolyline(points);
-      }
+    const int color = color_nr++ % 8;
+    screen_series &s = gi->line_screen;
+    map_line(gi->avg_data, gi->generation, 
+	  rect.width(), rect.height(), min, max, &s);
+
+    paint.setPen(color_line[color]);
+    for(int k=0; k<s.count(); ++k) {
+      const int asize = s.runs[k+1] - s.runs[k];
+      if (buf.polygon.size() < asize)
+	buf.polygon.resize(asize);
+      for(int l = s.runs[k], p = 0; p < asize; ++l, ++p)
+	buf.polygon[p] = 
+	  QPoint(rect.left() + int(s.x[l]), rect.top() + int(s.lo[l]));
+      paint.drawPolyline(buf.polygon.constData(), asize);
+      buf.stats.points += asize;
     }
   }
   paint.restore();
 }
 
 /**
- * draw the widgets contents.
+ * draw the graph itself antialiased with the Rasterizer
  *
- * this covers a grid, the graph istself, x- and y-label and a header
+ * the panel is rendered into an image of its size
  */
-void Graph::drawAll()
+void Graph::rasterGraph(QPainter &paint, const QRect &rect, 
+      const GraphInfo &ginfo, double min, double max, panel_buffers &buf)
 {
-  const int numgraphs =  glist.size();
+  if (buf.raster.size() != rect.size())
+    buf.raster = QImage(rect.size(), QImage::Format_ARGB32_Premultiplied);
+  buf.raster.fill(0);
+  Rasterizer raster(&buf.raster);
 
-  if (numgraphs) {
-    if (!data_is_valid)
-      fetchAllData ();
+  // draw all min/max backshadows
+  int color_nr = 0;
+  for(GraphInfo::const_iterator gi = ginfo.begin(); gi != ginfo.end(); ++gi) {
+    const int color = color_nr++ % 8;
+    screen_series &s = gi->band_screen;
+    map_band(gi->min_data, gi->max_data, gi->generation, 
+	  rect.width(), rect.height(), min, max, &s);
+    for(int k=0; k<s.count(); ++k) {
+      const int first = s.runs[k], asize = s.runs[k+1] - first;
+      raster.band(&s.x[first], &s.lo[first], &s.hi[first], asize, 
+	    color_minmax[color]);
+      buf.stats.points += 2*asize;
+    }
+  }
 
-    // clear
-    QPainter paint(&offscreen);
-    paint.setFont(font);
-    paint.eraseRect(0, 0, contentsRect().width(), contentsRect().height());
-    //paint.fillRect(0, 0, contentsRect().width(), contentsRect().height(), QColor(245, 245, 245));
-    
-    // margin calculations
-    // place for labels at the left and two line labels below
-    const QFontMetrics &fontmetric = paint.fontMetrics();
-    const QFontMetrics smallmetric = QFontMetrics(small_font);
-    const QFontMetrics headermetric = QFontMetrics(header_font);
-
-    time_iterator minor_x, major_x, label_x;
-    QString format_x;
-    bool center_x;
-    findXGrid(graph_rect.width(), format_x, center_x, minor_x, major_x, label_x);
-    drawHeader(paint);
-    
-    int n = 0;
-    for(graph_list::iterator i = begin(); i != end(); ++n, ++i) {
-      const int top = i->top() - contentsRect().top();
-      const int bottom = i->bottom() - contentsRect().top();
-
-      // y-scaling
-      double base;
-      Range y_range = i->minmax_adj(&base);
-      if (!y_range.isValid())
-	continue;
-      
-      // geometry
-      const int xlabel_base = bottom + marg + smallmetric.ascent();
-      const int legend_base = top + graph_height + fontmetric.ascent();
-      
-      // panel area
-      QRect panelrect(graph_rect.left(), top, graph_rect.width(), bottom-top);
-      
-      // graph-background
-      paint.fillRect(panelrect, color_graph_bg);
-      
-      // draw minor, major, graph
-      drawXLabel(paint, xlabel_base, graph_rect.left(), graph_rect.right(), 
-	    label_x, format_x, center_x);
-      drawXLines(paint, panelrect, minor_x, color_minor);
-      drawYLines(paint, panelrect, y_range, base/10, color_minor);
-      drawXLines(paint, panelrect, major_x, color_major);
-      drawYLines(paint, panelrect, y_range, base, color_major);
-      drawYLabel(paint, panelrect, y_range, base);
-      drawGraph(paint, panelrect, *i, y_range.min(), y_range.max());
-      drawLegend(paint, marg, legend_base, box_size, *i);
+  // draw all averages
+  color_nr = 0;
+  for(GraphInfo::const_iterator gi = ginfo.begin(); gi != ginfo.end(); ++gi) {
+    const int color = color_nr++ % 8;
+    screen_series &s = gi->line_screen;
+    map_line(gi->avg_data, gi->generation, 
+	  rect.width(), rect.height(), min, max, &s);
+    for(int k=0; k<s.count(); ++k) {
+      const int first = s.runs[k], asize = s.runs[k+1] - first;
+      raster.line(&s.x[first], &s.lo[first], asize, color_line[color]);
+      buf.stats.points += asize;
     }
-    paint.end();
-    // copy to screen
-    QPainter(this).drawPixmap(contentsRect(), offscreen);
-  } else {
-    QPainter paint(this);
-    paint.eraseRect(contentsRect());
-    const QString label(i18n("Drop sensors from list here"));
-    const int labelwidth = paint.fontMetrics().width(label);
-    paint.drawText((width()-labelwidth)/2, height()/2, label);
-    paint.end();
   }
+
+  paint.drawImage(rect.topLeft(), buf.raster);
 }
 
-void Graph::layout() 
-{
+/**
+ * draw the time-shifted overlay dimmed over the curves
+ */
+void Graph::drawShifted(QPainter &paint, const QRect &rect, 
+      const GraphInfo &ginfo, double min, double max, panel_buffers &buf)
+{
+  if (!time_shift)
+    return;
+
+  paint.save();
+  paint.setRenderHint(QPainter::Antialiasing, antialias_);
+  int color_nr = 0;
+  for(GraphInfo::const_iterator gi = ginfo.begin(); gi != ginfo.end(); ++gi) {
+    const int color = color_nr++ % 8;
+    screen_series &s = gi->shift_screen;
+    map_line(gi->shift_data, gi->shift_generation, 
+	  rect.width(), rect.height(), min, max, &s);
+
+    paint.setPen(color_shift[color]);
+    for(int k=0; k<s.count(); ++k) {
+      const int asize = s.runs[k+1] - s.runs[k];
+      if (buf.polygon.size() < asize)
+	buf.polygon.resize(asize);
+      for(int l = s.runs[k], p = 0; p < asize; ++l, ++p)
+	buf.polygon[p] = 
+	  QPoint(rect.left() + int(s.x[l]), rect.top() + int(s.lo[l]));
+      paint.drawPolyline(buf.polygon.constData(), asize);
+      buf.stats.points += asize;
+    }
+  }
+  paint.restore();
+}
+
+/**
+ * draw the live-values, stitched to the last valid rrd-value
+ */
+void Graph::drawLive(QPainter &paint, const QRect &rect, 
+      const GraphInfo &ginfo, double min, double max, panel_buffers &buf)
+{
+  if (!live_feed)
+    return;
+
+  const linMap ymap(min, rect.bottom(), max, rect.top());
+  const linMap tmap(data_start, rect.left(), data_end, rect.right());
+  QPolygon points;
+
+  paint.save();
+  paint.setClipRect(rect);
+  int color_nr = 0;
+  for(GraphInfo::const_iterator gi = ginfo.begin(); gi != ginfo.end(); ++gi) {
+    const int color = color_nr++ % 8;
+    live_map::const_iterator tail = live_tails.find(gi->ring);
+    if (!gi->ring || tail == live_tails.end()) continue;
+
+    const std::vector<double> &avg_data = gi->avg_data;
+    int l = avg_data.size() - 1;
+    while (l >= 0 && isnan(avg_data[l])) --l;
+    const double last_time = data_start + (l + 1) * double(step);
+
+    points.resize(0);
+    if (l >= 0) {
+      const linMap xmap(0, rect.left(), avg_data.size()-1, rect.right());
+      points << QPoint(xmap(l), ymap(avg_data[l]));
+    }
+    const std::vector<LiveRing::sample> &samples = tail->second;
+    for(size_t k=0; k<samples.size(); ++k) {
+      if (samples[k].time > last_time && samples[k].time <= data_end)
+	points << QPoint(tmap(samples[k].time), ymap(samples[k].value));
+    }
+    if (points.size() < 2) continue;
+    paint.setPen(color_line[color]);
+    paint.drawPolyline(points);
+    buf.stats.points += points.size();
+  }
+  paint.restore();
+}
+
+/**
+ * render panel @a n with its labels and legend into its own image
+ *
+ * called on worker-threads by drawAll(), so only the panel_buffers of
+ * the panel and the datasources of the panel may be changed.
+ */
+void Graph::drawPanel(int n)
+{
+  TraceSpan trace("subgraph", "render");
+  panel_buffers &buf = panel_bufs[n];
+  GraphInfo &ginfo = glist[n];
+  buf.stats.reset();
+  buf.range = Range();
+
+  const QFontMetrics fontmetric(font);
+  const QFontMetrics smallmetric(small_font);
+  const int top = ginfo.top() - contentsRect().top();
+  const int bottom = ginfo.bottom() - contentsRect().top();
+
+  // the image reaches from above the highest y-label to the next
+  // panel, images of neighbours overlap and are transparent
+  buf.origin = top - fontmetric.ascent();
+  const int end = n + 1 < int(glist.size()) 
+    ? glist[n+1].top() - contentsRect().top() : offscreen.height();
+  const QSize size(offscreen.width(), end - buf.origin);
+  if (buf.image.size() != size)
+    buf.image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+  buf.image.fill(0);
+
+  // y-scaling
+  double base;
+  Range y_range;
+  {
+    StageTimer timer(buf.stats, PerfStats::minmax);
+    TraceSpan trace("minmax", "render");
+    y_range = ginfo.minmax_adj(&base);
+  }
+  if (!y_range.isValid())
+    return;
+
+  QPainter paint(&buf.image);
+  paint.translate(0, -buf.origin);
+  paint.setFont(font);
+
+  // geometry
+  const int xlabel_base = bottom + marg + smallmetric.ascent();
+  const int legend_base = top + graph_height + fontmetric.ascent();
+
+  // panel area
+  QRect panelrect(graph_rect.left(), top, graph_rect.width(), bottom-top);
+  buf.rect = panelrect;
+  buf.range = y_range;
+
+  // graph-background
+  paint.fillRect(panelrect, color_graph_bg);
+
+  // draw minor, major, graph
+  drawXLabel(paint, xlabel_base);
+  drawXLines(paint, panelrect, grid.minor, color_minor);
+  drawYLines(paint, panelrect, y_range, base/10, color_minor);
+  drawXLines(paint, panelrect, grid.major, color_major);
+  drawYLines(paint, panelrect, y_range, base, color_major);
+  drawYLabel(paint, panelrect, y_range, base, buf);
+  {
+    StageTimer timer(buf.stats, PerfStats::graph);
+    // with OpenGL the curves are drawn by the GLCanvas
+    if (!gl_canvas && antialias_)
+      rasterGraph(paint, panelrect, ginfo, y_range.min(), y_range.max(), buf);
+    else if (!gl_canvas)
+      drawGraph(paint, panelrect, ginfo, y_range.min(), y_range.max(), buf);
+    drawShifted(paint, panelrect, ginfo, y_range.min(), y_range.max(), buf);
+    drawLive(paint, panelrect, ginfo, y_range.min(), y_range.max(), buf);
+  }
+  {
+    StageTimer timer(buf.stats, PerfStats::legend);
+    drawLegend(paint, marg, legend_base, box_size, ginfo);
+  }
+}
+
+/**
+ * draw the widgets contents into the offscreen-pixmap.
+ *
+ * this covers a grid, the graph istself, x- and y-label and a header.
+ * On screen a new view may be @a progressive, see fetchAllData().
+ */
+void Graph::drawAll(bool progressive)
+{
+  const int numgraphs =  glist.size();
+
+  if (numgraphs) {
+    frame_stats.reset();
+    const double frame_started = monotonic_seconds();
+
+    {
+      StageTimer timer(frame_stats, PerfStats::fetch);
+      fetchAllData (progressive);
+      fetchShifted();
+      updateStats();
+    }
+    for(graph_list::iterator i = begin(); i != end(); ++i)
+      for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j)
+	j->drawn = frame_started;
+    if (frame_stats.rows)
+      emit dataFetched();
+    if (autoUpdateTimer > 0)
+      watchFiles();
+
+    // clear
+    QPainter paint(&offscreen);
+    paint.setFont(font);
+    paint.eraseRect(0, 0, contentsRect().width(), contentsRect().height());
+    //paint.fillRect(0, 0, contentsRect().width(), contentsRect().height(), QColor(245, 245, 245));
+    
+    findXGrid(graph_rect.width(), grid.format, grid.center, 
+	  grid.minor, grid.major, grid.label);
+    grid.format = i18n(grid.format.toAscii());
+    updateXLabels();
+    label_color = palette().windowText().color();
+    drawHeader(paint);
+
+    // panels are independent, render them in parallel if text can be
+    // drawn outside of the GUI-thread
+    panel_bufs.resize(numgraphs);
+    if (numgraphs == 1 || !QFontDatabase::supportsThreadedFontRendering()) {
+      for(int n = 0; n < numgraphs; ++n)
+	drawPanel(n);
+    } else {
+      for(int n = 0; n < numgraphs; ++n)
+	render_pool.start(new PanelJob(this, n));
+      render_pool.waitForDone();
+    }
+
+#ifdef HAVE_OPENGL
+    if (gl_canvas)
+      gl_canvas->beginFrame(gl_dirty);
+    gl_dirty = false;
+#endif
+    for(int n = 0; n < numgraphs; ++n) {
+      const panel_buffers &buf = panel_bufs[n];
+      paint.drawImage(0, buf.origin, buf.image);
+      frame_stats += buf.stats;
+#ifdef HAVE_OPENGL
+      if (gl_canvas && buf.range.isValid())
+	frame_stats.points += gl_canvas->addPanel(n, buf.rect, 
+	      buf.range.min(), buf.range.max(), glist[n], 
+	      color_minmax, color_line);
+#endif
+    }
+    paint.end();
+#ifdef HAVE_OPENGL
+    if (gl_canvas)
+      gl_canvas->setBackground(offscreen);
+#endif
+
+    frame_stats.seconds[PerfStats::total] = monotonic_seconds() - frame_started;
+    last_stats = frame_stats;
+    adaptInterval();
+  }
+}
+
+/**
+ * fetch and render everything into the offscreen-pixmap without
+ * touching the screen. Used for offscreen-rendering (e.g. replay).
+ */
+const QPixmap &Graph::redraw()
+{
+  if (offscreen.size() != contentsRect().size())
+    layout();
+  drawAll();
+  return offscreen;
+}
+
+void Graph::layout() 
+{
   const int numgraphs =  glist.size();
   if (!numgraphs) return;
 
   // resize offscreen-map to widget-size
   offscreen = QPixmap(contentsRect().width(), contentsRect().height());
+  gl_dirty = true;
 
   QPainter paint(&offscreen);
   paint.setFont(font);
@@ -733,11 +1662,43 @@ void Graph::layout()
 void Graph::paintEvent(QPaintEvent *e)
 {
   QFrame::paintEvent(e);
-  drawAll();
+#ifdef HAVE_OPENGL
+  if (gl_canvas)
+    gl_canvas->setVisible(!glist.empty());
+#endif
+  if (!glist.empty()) {
+    // a moving crosshair only needs the offscreen-pixmap again
+    const bool overlay_only = hover_pending && !offscreen.isNull()
+      && (e->region() - hover_damage).isEmpty();
+    hover_pending = false;
+    hover_damage = QRegion();
+    if (!overlay_only) {
+      drawAll(true);
+      layoutHover();
+    }
+    // copy to screen, the GLCanvas gets it as background
+    if (!gl_canvas) {
+      QPainter paint(this);
+      const QRect r = e->rect() & contentsRect();
+      paint.drawPixmap(r, offscreen, r.translated(-contentsRect().topLeft()));
+      drawCrosshair(paint);
+    }
+  } else {
+    QPainter paint(this);
+    paint.eraseRect(contentsRect());
+    const QString label(i18n("Drop sensors from list here"));
+    const int labelwidth = paint.fontMetrics().width(label);
+    paint.drawText((width()-labelwidth)/2, height()/2, label);
+    paint.end();
+  }
 }
 
 void Graph::resizeEvent(QResizeEvent *e) 
 {
+#ifdef HAVE_OPENGL
+  if (gl_canvas)
+    gl_canvas->setGeometry(contentsRect());
+#endif
   layout();
 }
 
@@ -759,29 +1720,213 @@ Graph::graph_list::const_iterator Graph::graphAt(const QPoint &pos) const
   return end();
 }
 
+/**
+ * switch the overlay showing the counters of the last frame on or off
+ */
+void Graph::perfOverlay(bool on)
+{
+  perf_overlay = on;
+  update();
+}
+
+/**
+ * true if kcollectd was built with OpenGL and the display supports it
+ */
+bool Graph::openGLAvailable()
+{
+#ifdef HAVE_OPENGL
+  return QGLFormat::hasOpenGL();
+#else
+  return false;
+#endif
+}
+
+/**
+ * switch the statistics in the legend on or off
+ */
+void Graph::legendStats(bool on)
+{
+  legend_stats = on;
+  layout();
+  update();
+}
+
+/**
+ * switch the antialiased software-rendering on or off
+ */
+void Graph::antialias(bool on)
+{
+  antialias_ = on;
+  update();
+}
+
+/**
+ * draw bands and lines with OpenGL or QPainter, returns whether
+ * OpenGL is used afterwards
+ */
+bool Graph::openGL(bool on)
+{
+#ifdef HAVE_OPENGL
+  if (on && !gl_canvas && openGLAvailable()) {
+    gl_canvas = new GLCanvas(this);
+    gl_canvas->setGeometry(contentsRect());
+    gl_canvas->show();
+    gl_dirty = true;
+  } else if (!on && gl_canvas) {
+    delete gl_canvas;
+    gl_canvas = 0;
+  }
+#endif
+  update();
+  return gl_canvas != 0;
+}
+
+/**
+ * counters of the last frame, for scripting via D-Bus
+ */
+QString Graph::perfCounters() const
+{
+  return last_stats.toString();
+}
+
 /**
  * switch auto-update on or off
  * 
- * Auto-update does a update every 10 sec.
+ * Auto-update does a update every updateInterval() ms, or less often
+ * if that would not change the picture, see adaptInterval().
  */
 void Graph::autoUpdate(bool active)
 {
+  if (recorder_) recorder_->record("auto", active);
+
   if (active == true) {
     if (autoUpdateTimer == -1) {
-      autoUpdateTimer = startTimer(10000);
-      timer_diff = 0.99 * span;
-      start = time(0) - timer_diff;
+      effective_interval = update_interval;
+      autoUpdateTimer = suspended_ ? 0 : startTimer(effective_interval);
+      timer_diff = followDiff();
+      start = currentTime() - timer_diff;
       data_is_valid = false;
       update();
     }
   } else {
-    if (autoUpdateTimer != -1) {
+    if (autoUpdateTimer > 0)
       killTimer(autoUpdateTimer);
-      autoUpdateTimer = -1;
+    autoUpdateTimer = -1;
+    align_timer.stop();
+    file_watch.watch(std::set<std::string>());
+  }
+}
+
+/**
+ * the sample-vectors of @a d in the order of datasource::packed
+ */
+static void sample_vectors(GraphInfo::datasource &d, std::vector<double> *v[4])
+{
+  v[0] = &d.avg_data;
+  v[1] = &d.min_data;
+  v[2] = &d.max_data;
+  v[3] = &d.shift_data;
+}
+
+/**
+ * pause auto-update while the graph is not shown, keeping the fetched
+ * data, packed if pack_suspended. Resuming catches up with the files
+ * at once.
+ */
+void Graph::suspend(bool on)
+{
+  if (on == suspended_)
+    return;
+  suspended_ = on;
+
+  // refinements would write into the packed series, fetch again instead
+  if (on && cancelRefine())
+    data_is_valid = false;
+
+  std::vector<double> *v[4];
+  for(graph_list::iterator i = begin(); i != end(); ++i)
+    for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j) {
+      sample_vectors(*j, v);
+      for(int k=0; k<4; ++k) {
+	if (on && pack_suspended && !v[k]->empty()) {
+	  j->packed[k].pack(*v[k]);
+	  std::vector<double>().swap(*v[k]);
+	} else if (!on && !j->packed[k].empty()) {
+	  j->packed[k].unpack(*v[k]);
+	  j->packed[k].clear();
+	}
+      }
     }
+
+  if (autoUpdateTimer == -1)
+    return;
+
+  if (on) {
+    killTimer(autoUpdateTimer);
+    autoUpdateTimer = 0;
+    align_timer.stop();
+    file_watch.watch(std::set<std::string>());
+  } else {
+    autoUpdateTimer = startTimer(effective_interval);
+    tick();
   }
 }
 
+/**
+ * bytes held by the series and panel-images
+ */
+size_t Graph::memoryUsage() const
+{
+  size_t bytes = 0;
+  for(graph_list::const_iterator i = begin(); i != end(); ++i)
+    for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j)
+      bytes += series_bytes(*j);
+  for(std::vector<panel_buffers>::const_iterator b = panel_bufs.begin(); 
+      b != panel_bufs.end(); ++b)
+    bytes += b->image.bytesPerLine() * b->image.height() 
+      + b->raster.bytesPerLine() * b->raster.height();
+  return bytes;
+}
+
+/**
+ * drop the samples of @a d and everything cached from them, they are
+ * fetched again with the next frame showing them
+ */
+void Graph::release(GraphInfo::datasource &d)
+{
+  std::vector<double>().swap(d.avg_data);
+  std::vector<double>().swap(d.min_data);
+  std::vector<double>().swap(d.max_data);
+  std::vector<double>().swap(d.shift_data);
+  for(int k=0; k<4; ++k)
+    d.packed[k].clear();
+  d.band_screen = screen_series();
+  d.line_screen = screen_series();
+  d.shift_screen = screen_series();
+  d.stats = series_stats();
+  d.shift_step = 0;
+  d.fetched = false;
+  ++d.generation;
+  gl_dirty = true;
+}
+
+/**
+ * drop what is derived from the samples of @a d but keep the samples,
+ * screen-series and statistics are rebuilt and the time-shifted
+ * overlay is fetched again when needed
+ */
+void Graph::dropCaches(GraphInfo::datasource &d)
+{
+  std::vector<double>().swap(d.shift_data);
+  d.band_screen = screen_series();
+  d.line_screen = screen_series();
+  d.shift_screen = screen_series();
+  d.stats = series_stats();
+  d.shift_step = 0;
+  ++d.shift_generation;
+  gl_dirty = true;
+}
+
 /**
  *
  */
@@ -792,8 +1937,22 @@ void Graph::removeGraph()
 
   graph_list::iterator target = graphAt(QPoint(0, origin_y));
   if (target != end()) {
+    // keep pending wildcard-expansions pointing to the right graph
+    const size_t removed = target - begin();
+    for(std::deque<pending_plot>::iterator i = pending.begin(); 
+	i != pending.end(); ) {
+      if (i->graph == removed) {
+	i = pending.erase(i);
+      } else {
+	if (i->graph > removed) --i->graph;
+	++i;
+      }
+    }
     glist.erase(target);
     changed(true);
+    // refinements address the panels by index, start over for the rest
+    if (cancelRefine())
+      startRefine(1);
   }
   layout();
   update();
@@ -804,12 +1963,156 @@ void Graph::removeGraph()
  */
 void Graph::splitGraph()
 {
+  if (recorder_) recorder_->record("split");
   add();
   layout();
   update();
 }
 
 
+/**
+ * draw values arriving from @a feed on top of the rrd-data, 0 switches
+ * live-values off. The feed has to outlive its use by the Graph.
+ */
+void Graph::live(LiveFeed *feed)
+{
+  for(graph_list::iterator i = begin(); i != end(); ++i)
+    for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j)
+      j->ring = 0;
+  live_tails.clear();
+
+  live_feed = feed;
+  if (live_feed)
+    live_timer.start(live_interval);
+  else
+    live_timer.stop();
+  update();
+}
+
+/**
+ * take new values out of the rings, repaint without refetching if
+ * any arrived
+ */
+void Graph::drainLive()
+{
+  if (!live_feed) return;
+
+  // older values are covered by the rrd or out of view
+  const double horizon = data_start;
+  const size_t max_samples = 10000;
+
+  bool fresh = false;
+  for(graph_list::iterator i = begin(); i != end(); ++i) {
+    for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j) {
+      if (j->aggregate != agg_none) continue;
+      if (!j->ring)
+	j->ring = live_feed->subscribe(j->rrd, j->ds);
+      if (!j->ring) continue;
+
+      std::vector<LiveRing::sample> &tail = live_tails[j->ring];
+      LiveRing::sample s;
+      while (j->ring->pop(&s)) {
+	tail.push_back(s);
+	fresh = true;
+      }
+      size_t old = 0;
+      while (old < tail.size() && tail[old].time < horizon) ++old;
+      if (tail.size() - old > max_samples) old = tail.size() - max_samples;
+      tail.erase(tail.begin(), tail.begin() + old);
+    }
+  }
+  if (fresh)
+    update();
+}
+
+/**
+ * (re)expand the wildcard-plots of all subgraphs against @a catalog
+ *
+ * generated datasources that do not match any more are removed at
+ * once, new matches are added in small steps from the event-loop so
+ * large expansions do not block the gui.
+ */
+void Graph::expandWildcards(const SensorCatalog &catalog)
+{
+  typedef std::pair<QString, QString> key;
+
+  pending.clear();
+  for(size_t g=0; g<glist.size(); ++g) {
+    GraphInfo &gi = glist[g];
+    if (gi.wildcards().empty()) continue;
+
+    std::set<key> present, wanted;
+    for(GraphInfo::const_iterator i = gi.begin(); i != gi.end(); ++i)
+      present.insert(key(i->rrd, i->ds));
+
+    for(std::vector<GraphInfo::wildcard>::const_iterator w 
+	  = gi.wildcards().begin(); w != gi.wildcards().end(); ++w) {
+      std::vector<const SensorCatalog::entry *> matches 
+	= catalog.match(w->rrd, w->ds);
+      for(size_t m=0; m<matches.size(); ++m) {
+	const key k(matches[m]->rrd, matches[m]->ds);
+	if (!wanted.insert(k).second || present.count(k)) 
+	  continue;
+	pending_plot p;
+	p.graph = g;
+	p.rrd = matches[m]->rrd;
+	p.ds = matches[m]->ds;
+	p.label = matches[m]->label;
+	pending.push_back(p);
+      }
+    }
+
+    for(GraphInfo::iterator i = gi.begin(); i != gi.end(); ) {
+      if (i->generated && !wanted.count(key(i->rrd, i->ds)))
+	i = gi.erase(i);
+      else
+	++i;
+    }
+  }
+
+  if (pending.empty())
+    expand_timer.stop();
+  else
+    expand_timer.start(expand_delay);
+  layout();
+  update();
+}
+
+/**
+ * add all pending wildcard-expansions at once, for batch-use without
+ * an event-loop
+ */
+void Graph::expandAll()
+{
+  while(!pending.empty())
+    expandStep();
+}
+
+/**
+ * add the next batch of pending wildcard-expansions
+ *
+ * only the new datasources get fetched on the next repaint.
+ */
+void Graph::expandStep()
+{
+  for(int n=0; n<expand_batch && !pending.empty(); ++n) {
+    const pending_plot &p = pending.front();
+    if (p.graph < glist.size()) {
+      GraphInfo::datasource d;
+      d.rrd = p.rrd;
+      d.ds = p.ds;
+      d.label = p.label;
+      d.generated = true;
+      glist[p.graph].add(d);
+    }
+    pending.pop_front();
+  }
+  if (pending.empty())
+    expand_timer.stop();
+  layout();
+  update();
+}
+
 /**
  * Qt mouse-press-event
  */
@@ -826,6 +2129,9 @@ void Graph::mousePressEvent(QMouseEvent *e)
     // map for delete-datasource-options
     typedef std::map<QAction *, GraphInfo::iterator> actionmap;
     actionmap acts; 
+    // map for aggregate-options
+    typedef std::map<QAction *, const aggregate_entry *> aggmap;
+    aggmap aggs;
     
     // context-menu
     KMenu menu(this);
@@ -846,6 +2152,16 @@ void Graph::mousePressEvent(QMouseEvent *e)
 	      i18n("remove ") + i->label);
 	acts[T] = i;
       }
+
+      if (s_graph->size() > 1) {
+	const size_t n = sizeof(aggregate_entries)/sizeof(*aggregate_entries);
+	menu.addSeparator();
+	QMenu *aggmenu = menu.addMenu(i18n("aggregate datasources"));
+	for(size_t i=0; i<n; ++i) {
+	  QAction *T = aggmenu->addAction(i18n(aggregate_entries[i].label));
+	  aggs[T] = &aggregate_entries[i];
+	}
+      }
     }
 
     QAction *action = menu.exec(e->globalPos());
@@ -856,6 +2172,18 @@ void Graph::mousePressEvent(QMouseEvent *e)
       layout();
       update();
     }
+
+    aggmap::iterator agg = aggs.find(action);
+    if (agg != aggs.end()) {
+      const aggregate_entry *entry = agg->second;
+      s_graph->aggregate(entry->fn, entry->quantile, QString());
+      s_graph->begin()->label = i18n("%1 of %2 datasources", 
+	    i18n(entry->label), int(s_graph->begin()->members.size()));
+      changed(true);
+      data_is_valid = false;
+      layout();
+      update();
+    }
   }
 }
 
@@ -881,24 +2209,225 @@ void Graph::mouseMoveEvent(QMouseEvent *e)
     int offset = (x - origin_x) * (origin_end - origin_start) 
       / graph_rect.width();
     
-    start = origin_start - offset;
-    const time_t now = time(0);
-    if (start + span > now + span * 2 / 3 )
-      start = now - span / 3;
-    
-    if (autoUpdateTimer != -1) 
-      timer_diff = time(0) - start;
-    
-    data_is_valid = false;
-    update();
+    pan(origin_start - offset - start);
   } else  if (e->buttons() == Qt::MidButton){
     dragging = true;
     update();
+  } else if (e->buttons() == Qt::NoButton && crosshair_) {
+    hoverAt(e->pos());
   } else {
     e->ignore();
   }
 }
 
+/**
+ * Qt leave-event, the crosshair goes with the mouse
+ */
+void Graph::leaveEvent(QEvent *)
+{
+  hideHover();
+}
+
+/**
+ * move the crosshair to @a pos in widget coordinates and repaint
+ * only the areas it leaves and enters
+ */
+void Graph::hoverAt(const QPoint &pos)
+{
+  const QRegion old = hoverRegion();
+  hover_pos = pos - contentsRect().topLeft();
+  layoutHover();
+  const QRegion damage = old + hoverRegion();
+  if (damage.isEmpty())
+    return;
+  hover_damage += damage;
+  hover_pending = true;
+  update(damage);
+}
+
+/**
+ * remove the crosshair until the mouse moves again
+ */
+void Graph::hideHover()
+{
+  const QRegion damage = hoverRegion();
+  hover_pos = QPoint(-1, -1);
+  hovering = false;
+  if (damage.isEmpty())
+    return;
+  hover_damage += damage;
+  hover_pending = true;
+  update(damage);
+}
+
+/**
+ * switch the crosshair with the values under the mouse on or off
+ */
+void Graph::crosshair(bool on)
+{
+  if (!on)
+    hideHover();
+  crosshair_ = on;
+  setMouseTracking(on);
+}
+
+/**
+ * row of a series of @a n rows drawn at @a x of a panel @a width
+ * pixels wide, the inverse of the mapping in map_line
+ */
+static size_t hover_row(size_t n, int width, int x)
+{
+  if (n < 2 || width < 2)
+    return 0;
+  const float xm = (width - 1.0f) / (n - 1);
+  return std::min(size_t(std::max(0.0f, x / xm + 0.5f)), n - 1);
+}
+
+/**
+ * snap the crosshair to the row under hover_pos and format the
+ * readout. Every series is looked up at its own row for its own size,
+ * so this costs one lookup per series and never touches the files.
+ */
+void Graph::layoutHover()
+{
+  hovering = false;
+  if (!crosshair_ || !data_is_valid || gl_canvas)
+    return;
+
+  size_t n = 0;
+  while (n < panel_bufs.size() && !panel_bufs[n].rect.contains(hover_pos))
+    ++n;
+  if (n == panel_bufs.size() || n >= glist.size() 
+      || !panel_bufs[n].range.isValid())
+    return;
+  const QRect &rect = panel_bufs[n].rect;
+  const GraphInfo &ginfo = glist[n];
+
+  // snap to a row of the finest series, the others may have other steps
+  GraphInfo::const_iterator finest = ginfo.end();
+  for(GraphInfo::const_iterator j = ginfo.begin(); j != ginfo.end(); ++j)
+    if (finest == ginfo.end() || j->avg_data.size() > finest->avg_data.size())
+      finest = j;
+  if (finest == ginfo.end() || finest->avg_data.empty())
+    return;
+  const size_t row = hover_row(finest->avg_data.size(), rect.width(), 
+	hover_pos.x() - rect.left());
+  const size_t rows = finest->avg_data.size();
+  hover_pos.setX(rect.left() 
+	+ (rows > 1 ? int(row * ((rect.width() - 1.0f) / (rows - 1))) : 0));
+  const int x = hover_pos.x() - rect.left();
+
+  // time first, then as many series as fit into the panel
+  const QFontMetrics fontmetric(small_font);
+  const int spacing = fontmetric.lineSpacing();
+  const int max_lines = std::max(1, (rect.height() - 2*marg) / spacing);
+  const time_t t = finest->rows_step 
+    ? finest->rows_start + (row + 1) * finest->rows_step
+    : data_start + (row + 1) * step;
+  hover_lines.resize(1);
+  hover_lines[0].color = QColor();
+  hover_lines[0].text = Qstrftime(i18n("%Y-%m-%d %H:%M:%S").toAscii(), 
+	localtime(&t));
+  int color_nr = 0;
+  int hidden = 0;
+  for(GraphInfo::const_iterator j = ginfo.begin(); j != ginfo.end(); ++j) {
+    const int color = color_nr++ % 8;
+    if (int(hover_lines.size()) >= max_lines) {
+      ++hidden;
+      continue;
+    }
+    const size_t n = j->avg_data.size();
+    const double v = n ? j->avg_data[hover_row(n, rect.width(), x)] 
+      : std::numeric_limits<double>::quiet_NaN();
+    QString value("-");
+    if (!isnan(v)) {
+      std::string SI;
+      double mag;
+      si_char(v, SI, mag);
+      char text[64];
+      int len = format_number(v/mag, 4, text);
+      if (!SI.empty()) {
+	text[len++] = ' ';
+	strcpy(text + len, SI.c_str());
+      }
+      value = text;
+    }
+    hover_line l;
+    l.color = color_line[color];
+    l.text = QString("%1: %2").arg(j->label).arg(value);
+    hover_lines.push_back(l);
+  }
+  if (hidden && hover_lines.size() > 1) {
+    hover_lines.back().color = QColor();
+    hover_lines.back().text = i18n("... and %1 more", hidden + 1);
+  }
+
+  // readout right of the line, left of it at the right edge
+  int width = 0;
+  for(std::vector<hover_line>::const_iterator i = hover_lines.begin(); 
+      i != hover_lines.end(); ++i)
+    width = std::max(width, fontmetric.width(i->text) 
+	  + (i->color.isValid() ? spacing : 0));
+  hover_box.setSize(QSize(width + 2*marg, 
+	  int(hover_lines.size()) * spacing + 2*marg));
+  hover_box.moveTopLeft(QPoint(hover_pos.x() + 4*marg, hover_pos.y() + 4*marg));
+  if (hover_box.right() > rect.right())
+    hover_box.moveRight(hover_pos.x() - 4*marg);
+  if (hover_box.left() < rect.left())
+    hover_box.moveLeft(rect.left());
+  if (hover_box.bottom() > rect.bottom())
+    hover_box.moveBottom(rect.bottom());
+  hover_panel = rect;
+  hovering = true;
+}
+
+/**
+ * widget area covered by the crosshair and its readout
+ */
+QRegion Graph::hoverRegion() const
+{
+  if (!hovering)
+    return QRegion();
+  QRegion r(hover_box);
+  r += QRect(hover_pos.x(), hover_panel.top(), 1, hover_panel.height());
+  r += QRect(hover_panel.left(), hover_pos.y(), hover_panel.width(), 1);
+  return r.translated(contentsRect().topLeft());
+}
+
+/**
+ * draw the crosshair over the already copied offscreen-pixmap
+ */
+void Graph::drawCrosshair(QPainter &paint)
+{
+  if (!hovering)
+    return;
+  paint.save();
+  paint.translate(contentsRect().topLeft());
+  paint.setPen(QColor(255, 255, 255, 140));
+  paint.drawLine(hover_pos.x(), hover_panel.top(), 
+	hover_pos.x(), hover_panel.bottom());
+  paint.drawLine(hover_panel.left(), hover_pos.y(), 
+	hover_panel.right(), hover_pos.y());
+
+  paint.setFont(small_font);
+  const QFontMetrics &fontmetric = paint.fontMetrics();
+  const int spacing = fontmetric.lineSpacing();
+  const int size = fontmetric.ascent() - 2;
+  paint.fillRect(hover_box, QColor(255, 255, 255, 200));
+  paint.setPen(Qt::black);
+  int y = hover_box.top() + marg + fontmetric.ascent();
+  for(std::vector<hover_line>::const_iterator i = hover_lines.begin(); 
+      i != hover_lines.end(); ++i, y += spacing) {
+    int x = hover_box.left() + marg;
+    if (i->color.isValid()) {
+      paint.fillRect(x, y - size, size, size, i->color);
+      x += spacing;
+    }
+    paint.drawText(x, y, i->text);
+  }
+  paint.restore();
+}
+
 /**
  *
  */
@@ -916,8 +2445,125 @@ void Graph::wheelEvent(QWheelEvent *e)
  */
 void Graph::timerEvent(QTimerEvent *event)
 {
-  data_is_valid = false;
-  start = time(0) - timer_diff;
+  scheduleTick();
+}
+
+/**
+ * run the next tick shortly after collectd is expected to write,
+ * instead of at some random phase of the rrd-step. While the files
+ * are watched writes come from there, the timer only follows now.
+ */
+void Graph::scheduleTick()
+{
+  if (align_timer.isActive())
+    return;
+  if (file_watch.isWatching() || last_write <= 0 || step <= 1) {
+    tick();
+    return;
+  }
+
+  const double now = wallclock_seconds();
+  double due = last_write + step + write_delay;
+  if (due < now)
+    due += ceil((now - due) / step) * step;
+  align_timer.start(int(1000 * (due - now)));
+}
+
+/**
+ * set the auto-update interval to @a ms milliseconds
+ */
+void Graph::updateInterval(int ms)
+{
+  update_interval = std::max(ms, 50);
+  if (autoUpdateTimer != -1) {
+    if (autoUpdateTimer > 0)
+      killTimer(autoUpdateTimer);
+    effective_interval = update_interval;
+    autoUpdateTimer = suspended_ ? 0 : startTimer(effective_interval);
+    timer_diff = followDiff();
+  }
+}
+
+/**
+ * distance from start of the graph to now in auto-update mode
+ *
+ * leaves room for two updates at the right edge, but at most 1% of
+ * the span.
+ */
+time_t Graph::followDiff() const
+{
+  const time_t room = std::max<time_t>(1, 2 * effective_interval / 1000);
+  return span - std::min<time_t>(span / 100, room);
+}
+
+/**
+ * back off from the user-set interval if an update could not move
+ * the graph by a pixel or if fetching takes longer than the interval
+ */
+void Graph::adaptInterval()
+{
+  if (autoUpdateTimer <= 0) return;
+
+  int interval = update_interval;
+  if (graph_rect.width() > 0)
+    interval = std::max(interval, int(1000.0 * span / graph_rect.width()));
+  interval = std::max(interval, 
+	int(2000.0 * last_stats.seconds[PerfStats::fetch]));
+
+  // avoid restarting the timer for jitter
+  if (abs(interval - effective_interval) > effective_interval / 10) {
+    killTimer(autoUpdateTimer);
+    effective_interval = interval;
+    autoUpdateTimer = startTimer(effective_interval);
+  }
+}
+
+/**
+ * watch the files of all displayed datasources for writes
+ */
+void Graph::watchFiles()
+{
+  std::set<std::string> files;
+  for(graph_list::const_iterator i = begin(); i != end(); ++i) {
+    for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j) {
+      if (j->aggregate == agg_none) {
+	files.insert(j->rrd.toUtf8().data());
+	continue;
+      }
+      for(std::vector<rrd_source>::const_iterator m = j->members.begin(); 
+	  m != j->members.end(); ++m)
+	files.insert(m->file);
+    }
+  }
+  file_watch.watch(files);
+}
+
+/**
+ * displayed files were written, refresh at once. FileWatch already
+ * coalesces a burst of writes, the backoff of the interval only
+ * paces the timer.
+ */
+void Graph::filesWritten()
+{
+  if (autoUpdateTimer <= 0)
+    return;
+
+  align_timer.stop();
+  tick();
+}
+
+/**
+ * one step of the auto-update: follow now and refetch, files not
+ * written since the last fetch are only shifted
+ */
+void Graph::tick()
+{
+  TraceSpan trace("tick", "timer");
+  if (recorder_) recorder_->record("tick");
+
+  last_tick = monotonic_seconds();
+  data_is_stale = true;
+  start = currentTime() - timer_diff;
   update();
 }
 
@@ -991,18 +2637,54 @@ void Graph::dropEvent(QDropEvent *event)
  */
 void Graph::last(time_t new_span)
 {
+  if (recorder_) recorder_->record("last", new_span);
+
   span = new_span;
   
   if (autoUpdateTimer != -1) {
-    timer_diff = 0.99 * span;
-    start = time(0) - timer_diff;
+    timer_diff = followDiff();
+    start = currentTime() - timer_diff;
   } else {
-    start = time(0) - 0.99 * span;
+    start = currentTime() - 0.99 * span;
   }
   data_is_valid = false;
   update();
 }
 
+/**
+ * show @a new_span seconds from @a new_start
+ */
+void Graph::view(time_t new_start, time_t new_span)
+{
+  if (recorder_) recorder_->record("view", new_start, new_span);
+
+  start = new_start;
+  span = new_span;
+  if (autoUpdateTimer != -1)
+    timer_diff = currentTime() - start;
+  data_is_valid = false;
+  update();
+}
+
+/**
+ * move the graph @a offset seconds in time
+ */
+void Graph::pan(time_t offset)
+{
+  if (recorder_) recorder_->record("pan", offset);
+
+  start += offset;
+  const time_t now = currentTime();
+  if (start + span > now + span * 2 / 3 )
+    start = now - span / 3;
+
+  if (autoUpdateTimer != -1) 
+    timer_diff = currentTime() - start;
+
+  data_is_valid = false;
+  update();
+}
+
 /**
  * zoom graph with factor
  */
@@ -1013,22 +2695,47 @@ void Graph::zoom(double factor)
 
   time_t time_center = data_end - span / 2;  
   if (time_center < 0) return;
+  if (recorder_) recorder_->record("zoom", factor);
   span *= factor;
   start = time_center - (span / 2);
 
-  const time_t now = time(0);
+  const time_t now = currentTime();
   if (start + span > now + span * 2 / 3 )
     start = now - span / 3;
 
   if (autoUpdateTimer != -1) {
-    timer_diff = 0.99 * span;
-    start = time(0) - timer_diff;
+    timer_diff = followDiff();
+    start = currentTime() - timer_diff;
   }
   
   data_is_valid = false;
   update();
 }
 
+/**
+ * replace all datasources by one aggregate of them
+ *
+ * members of aggregates already in this GraphInfo are taken over.
+ */
+void GraphInfo::aggregate(aggregate_fn fn, double quantile, 
+      const QString &label)
+{
+  datasource agg;
+  agg.label = label;
+  agg.aggregate = fn;
+  agg.quantile = quantile;
+  for(const_iterator i = begin(); i != end(); ++i) {
+    if (i->aggregate == agg_none)
+      agg.members.push_back(rrd_source(i->rrd.toUtf8().data(), 
+		i->ds.toUtf8().data()));
+    else
+      agg.members.insert(agg.members.end(), 
+	    i->members.begin(), i->members.end());
+  }
+  dslist.clear();
+  dslist.push_back(agg);
+}
+
 /**
  * returns range for y-values
  */
@@ -1043,6 +2750,10 @@ Range GraphInfo::minmax()
       else
 	r = a;
     }
+    // the overlay has no min/max, its own values stand in for them
+    Range s = ds_minmax(i->shift_data, i->shift_data, i->shift_data);
+    if (s.isValid())
+      r = r.isValid() ? range_max(r, s) : s;
   }
   return r;
 }
@@ -22,19 +22,40 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <time.h>
+
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
 
 #include <QFrame>
+#include <QImage>
 #include <QPixmap>
+#include <QPolygon>
 #include <QRect>
+#include <QRegion>
+#include <QThreadPool>
+#include <QTimer>
 #include <QMouseEvent>
 #include <QPaintEvent>
 #include <QWheelEvent>
 
 #include "misc.h"
-
-class time_iterator;
+#include "perfstats.h"
+#include "aggregate.h"
+#include "livefeed.h"
+#include "filewatch.h"
+#include "transform.h"
+#include "timeaxis.h"
+#include "stats.h"
+#include "compress.h"
+
+class ViewRecorder;
+class SensorCatalog;
+class GLCanvas;
+class SessionFile;
+class RefineJob;
 
 class GraphInfo
 {
@@ -44,12 +65,62 @@ public:
     QString rrd;
     QString ds;
     QString label;
+    // aggregates reduce all members into avg_data, bands into all three
+    aggregate_fn aggregate;
+    double quantile;
+    std::vector<rrd_source> members;
+    // expanded from a wildcard, not saved
+    bool generated;
+    // data fetched for the current view
+    bool fetched;
+    // monotonic time of the last frame showing it, for eviction
+    double drawn;
+    // mtime of the rrd (newest member for aggregates) at the fetch
+    double mtime;
+    // changed whenever the data changes
+    unsigned long generation;
+    // data mapped to the panel, kept between repaints
+    mutable screen_series band_screen, line_screen;
+    // statistics of the visible range for the legend
+    series_stats stats;
+    QString stats_label;
+    // live-values from the network, owned by the LiveFeed
+    LiveRing *ring;
+    // series in the snapshot of a session-file, -1 if none
+    int snapshot;
     std::vector<double> avg_data, min_data, max_data;
+    // start and step of the rows of the three above, files differ
+    time_t rows_start;
+    unsigned long rows_step;
+    // avg_data of the time-shifted overlay on the rows of avg_data,
+    // fetched from shift_start with shift_step
+    std::vector<double> shift_data;
+    time_t shift_start;
+    unsigned long shift_step, shift_generation;
+    unsigned long shift_source;	// generation of the rows copied from avg_data
+    mutable screen_series shift_screen;
+    // avg, min, max and shift_data packed while the graph is suspended
+    packed_series packed[4];
+    datasource() : aggregate(agg_none), quantile(0.5), 
+		   generated(false), fetched(false), drawn(0), mtime(0), 
+		   generation(0), 
+		   ring(0), snapshot(-1), rows_start(0), rows_step(0), 
+		   shift_start(0), shift_step(0), 
+		   shift_generation(0), shift_source(0) { }
+  };
+
+  struct wildcard {
+    QString rrd;
+    QString ds;
+    QString label;
   };
 
   void add(const QString &rrd, const QString &ds, const QString &label);
   void add(const datasource &d) { dslist.push_back(d); }
-  void clear() { dslist.clear(); }
+  void aggregate(aggregate_fn fn, double quantile, const QString &label);
+  void addWildcard(const QString &rrd, const QString &ds, const QString &label);
+  const std::vector<wildcard> &wildcards() const { return wildcard_list; }
+  void clear() { dslist.clear(); wildcard_list.clear(); }
   size_t size() const { return dslist.size(); }
   Range minmax();
   Range minmax_adj(double *base);
@@ -70,13 +141,14 @@ public:
   const_iterator begin() const { return dslist.begin(); } 
   const_iterator end() const   { return dslist.end(); }
 
-  void erase(iterator i) { dslist.erase(i); }
+  iterator erase(iterator i) { return dslist.erase(i); }
   bool empty() const { return dslist.empty(); }
 
 private:
   
   int top_, bottom_, legend_lines_;
   std::vector<datasource> dslist;
+  std::vector<wildcard> wildcard_list;
 };
 
 /**
@@ -101,6 +173,7 @@ class GraphMimeData : public QMimeData {
 class Graph : public QFrame
 {
   Q_OBJECT;
+  friend class PanelJob;
  public:
 
   typedef std::vector<GraphInfo> graph_list;
@@ -110,25 +183,66 @@ class Graph : public QFrame
   explicit Graph(QWidget *parent=0);
   Graph(QWidget *parent, const std::string &rrd, const std::string &ds, 
 	const char *name=0);
+  virtual ~Graph();
 
   void clear();
   GraphInfo &add(const QString &rrd, const QString &ds, const QString &label);
   GraphInfo &add();
+  void expandWildcards(const SensorCatalog &catalog);
+  void expandAll();
 
   bool changed() { return changed_state; }
   void changed(bool c) { changed_state = c; }
 
   void autoUpdate(bool active);
   bool autoUpdate() { return (autoUpdateTimer != -1); }
+  void suspend(bool on);
+  bool suspended() const { return suspended_; }
+  void packSuspended(bool on) { pack_suspended = on; }
+  size_t memoryUsage() const;
+  void release(GraphInfo::datasource &d);
+  void dropCaches(GraphInfo::datasource &d);
+  void updateInterval(int ms);
+  int updateInterval() const { return update_interval; }
+  int effectiveInterval() const { return effective_interval; }
+
+  void recorder(ViewRecorder *r);
+  ViewRecorder *recorder() const { return recorder_; }
+  void clock(time_t now) { clock_ = now; }
+  unsigned long fetches() const { return fetch_count; }
+
+  void live(LiveFeed *feed);
+  LiveFeed *live() const { return live_feed; }
+
+  const PerfStats &stats() const { return last_stats; }
+  void perfOverlay(bool on);
+  bool perfOverlay() const { return perf_overlay; }
+
+  static bool openGLAvailable();
+  bool openGL(bool on);
+  bool openGL() const { return gl_canvas != 0; }
+  void antialias(bool on);
+  bool antialias() const { return antialias_; }
+  void legendStats(bool on);
+  bool legendStats() const { return legend_stats; }
+  void timeShift(time_t offset);
+  time_t timeShift() const { return time_shift; }
+  void crosshair(bool on);
+  bool crosshair() const { return crosshair_; }
+
+  const QPixmap &redraw();
 
   virtual QSize sizeHint() const;
   virtual void paintEvent(QPaintEvent *ev);
   virtual void resizeEvent(QResizeEvent*);
   
   virtual void last(time_t span);
+  void view(time_t new_start, time_t new_span);
   virtual void zoom(double factor);
+  virtual void pan(time_t offset);
   virtual void mousePressEvent(QMouseEvent *e);
   virtual void mouseMoveEvent(QMouseEvent *e);
+  virtual void leaveEvent(QEvent *e);
   virtual void wheelEvent(QWheelEvent *e);
   virtual void timerEvent(QTimerEvent *event);
   // drag-and-drop
@@ -143,15 +257,39 @@ class Graph : public QFrame
   const_iterator end() const   { return glist.end(); }
 
   bool empty() const { return glist.empty(); }
-  time_t range() { return span; }
+  time_t range() const { return span; }
+  time_t viewStart() const { return start; }
+
+  // the data of the current view
+  bool dataValid() const { return data_is_valid; }
+  time_t dataStart() const { return data_start; }
+  time_t dataEnd() const { return data_end; }
+  unsigned long dataStep() const { return step; }
+
+  void snapshot(SessionFile *session);
+
+signals:
+  void dataFetched();
 
 public slots:
   virtual void removeGraph();
   virtual void splitGraph();
+  virtual void tick();
+  Q_SCRIPTABLE QString perfCounters() const;
+
+ private slots:
+  void expandStep();
+  void drainLive();
+  void filesWritten();
+  void decodeStep();
+  void refineDone();
 
  private:
-  bool fetchAllData();
-  void drawAll();
+  bool fetchAllData(bool progressive = false);
+  void fetchShifted();
+  void startRefine(int pass);
+  bool cancelRefine();
+  void drawAll(bool progressive = false);
   int calcLegendHeights(int box_size, int width);
   void drawLegend(QPainter &paint, int left, int pos, 
 	int box_size, const GraphInfo &ginfo);
@@ -159,17 +297,58 @@ public slots:
   void drawHeader(QPainter &paint);
   void drawYLines(QPainter &paint, const QRect &rect, 
 	const Range &y_range, double base, QColor color);
-  void drawYLabel(QPainter &paint, const QRect &rect, 
-	const Range &range, double base);
   void drawXLines(QPainter &paint, const QRect &rect, 
 	time_iterator it, QColor color);
-  void drawXLabel(QPainter &paint, int y, int left, int right, 
-	time_iterator it, QString format, bool center);
+  void drawXLabel(QPainter &paint, int y);
+  void updateXLabels();
+  int sampleWidth(const char *format);
   void findXGrid(int width, QString &format, bool &center, 
        time_iterator &minor_x, time_iterator &major_x, time_iterator &label_x );
+  // preformatted axis-label
+  struct tick_label {
+    QPoint pos;
+    QString text;
+  };
+
+  // software-rendering of a panel, buffers reused between frames
+  struct panel_buffers {
+    QImage image;		// panel with labels and legend
+    int origin;			// y of image in offscreen
+    QRect rect;			// the panel itself in offscreen
+    Range range;		// y-range, invalid if nothing to draw
+    QImage raster;		// antialiased curves
+    QPolygon polygon;
+    PerfStats stats;
+    std::vector<tick_label> ylabels; // y-labels for the axis below
+    QRect ylabel_rect;
+    Range ylabel_range;
+    double ylabel_base;
+    panel_buffers() : origin(0), ylabel_base(0) { }
+  };
+
+  void drawPanel(int n);
+  void drawYLabel(QPainter &paint, const QRect &rect, 
+	const Range &range, double base, panel_buffers &buf);
   void drawGraph(QPainter &paint, const QRect &rect, const GraphInfo &gi, 
-	double min, double max);
+	double min, double max, panel_buffers &buf);
+  void drawLive(QPainter &paint, const QRect &rect, const GraphInfo &gi, 
+	double min, double max, panel_buffers &buf);
+  void drawShifted(QPainter &paint, const QRect &rect, const GraphInfo &gi, 
+	double min, double max, panel_buffers &buf);
+  void rasterGraph(QPainter &paint, const QRect &rect, const GraphInfo &gi, 
+	double min, double max, panel_buffers &buf);
   void layout();
+  void hoverAt(const QPoint &pos);
+  void hideHover();
+  void layoutHover();
+  QRegion hoverRegion() const;
+  void drawCrosshair(QPainter &paint);
+  time_t followDiff() const;
+  time_t currentTime() const { return clock_ ? clock_ : time(0); }
+  void adaptInterval();
+  void scheduleTick();
+  void watchFiles();
+  void updateStats();
   
   graph_list::iterator graphAt(const QPoint &pos);
   graph_list::const_iterator graphAt(const QPoint &pos) const;
@@ -177,6 +356,8 @@ public slots:
   // rrd-data
   graph_list glist;
   bool data_is_valid;
+  bool data_is_stale;	// view moved on, unchanged files can be shifted
+  double last_write;	// newest mtime of the displayed files
   time_t start;		// user set start of graph
   time_t span;		// user-set span of graph
   time_t data_start;	// real start of data (from rrd_fetch)
@@ -196,11 +377,94 @@ public slots:
   int graph_height, label_width, box_size;
   int label_y1, label_y2;
   QColor color_major, color_minor, color_graph_bg;
-  QColor color_minmax[8], color_line[8];
+  QColor color_minmax[8], color_line[8], color_shift[8];
 
-  // Auto-Update
+  // Auto-Update, autoUpdateTimer is 0 while suspended
   int autoUpdateTimer;
+  bool suspended_;		// not shown, no timers and no fetches
+  bool pack_suspended;		// keep the series packed while suspended
   time_t timer_diff;
+  int update_interval;		// user-set interval in ms
+  int effective_interval;	// interval after backoff in ms
+  QTimer align_timer;		// fires just after the next expected write
+  FileWatch file_watch;		// reports writes instead of polling
+  double last_tick;		// monotonic time of the last refresh
+
+  // benchmarking
+  ViewRecorder *recorder_;	// owned
+  time_t clock_;		// current time for replays, 0 is the real one
+  unsigned long fetch_count;
+
+  // instrumentation
+  PerfStats frame_stats, last_stats;
+  bool perf_overlay;
+
+  // optional OpenGL-backend drawing bands and lines
+  GLCanvas *gl_canvas;
+  bool gl_dirty;		// data or layout changed since last upload
+
+  // min/avg/max/p95/last in the legend
+  bool legend_stats;
+  int stats_width;		// fixed width of the stats_label
+
+  // the series again this much earlier, dimmed, 0 for none
+  time_t time_shift;
+
+  // crosshair following the mouse, drawn over the offscreen-pixmap,
+  // positions in contents coordinates
+  struct hover_line {
+    QColor color;		// invalid for lines without a series
+    QString text;
+  };
+  bool crosshair_;
+  bool hovering;		// mouse over a panel with data
+  bool hover_pending;		// repaint only for the crosshair
+  QPoint hover_pos;		// x snapped to the row under the mouse
+  QRect hover_panel, hover_box;
+  QRegion hover_damage;		// widget area of the pending repaint
+  std::vector<hover_line> hover_lines;
+
+  // parallel software-rendering of the panels
+  bool antialias_;
+  std::vector<panel_buffers> panel_bufs;
+  QThreadPool render_pool;
+  struct {
+    time_iterator minor, major, label;
+    QString format;		// translated
+    bool center;
+    std::vector<tick_label> labels; // x-labels, y relative to baseline
+    // axis the labels were made for
+    time_t key_interval, key_start, key_end, key_first;
+    int key_left, key_right;
+    QString key_format;
+    bool key_center;
+  } grid;			// x-grid of the current frame
+  label_cache time_labels;	// formatted times of the x-axis
+  std::map<const char *, int> sample_widths; // label-widths in findXGrid
+  QColor label_color;
+
+  // wildcard-expansions not yet added
+  struct pending_plot {
+    size_t graph;
+    QString rrd, ds, label;
+  };
+  std::deque<pending_plot> pending;
+  QTimer expand_timer;
+
+  // snapshot of a session-file, decoded a panel at a time
+  SessionFile *session;
+  std::deque<std::pair<size_t, size_t> > pending_decode; // graph, plot
+  QTimer decode_timer;
+
+  // finer passes of a view first shown from the coarsest RRA
+  std::deque<RefineJob *> refine_jobs;
+  QThreadPool refine_pool;
+
+  // live-values newer than the rrd-data
+  typedef std::map<LiveRing *, std::vector<LiveRing::sample> > live_map;
+  LiveFeed *live_feed;
+  QTimer live_timer;
+  live_map live_tails;
 
   // state
   bool changed_state;
@@ -219,6 +483,20 @@ GraphInfo::add(const QString &rrd, const QString &ds, const QString &label)
   dslist.push_back(new_ds);
 }
 
+/**
+ * add a wildcard-plot to the GraphInfo
+ */
+inline void 
+GraphInfo::addWildcard(const QString &rrd, const QString &ds, 
+      const QString &label)
+{
+  wildcard w;
+  w.rrd = rrd;
+  w.ds = ds;
+  w.label = label;
+  wildcard_list.push_back(w);
+}
+
 /**
  * set graph-infos.
  */
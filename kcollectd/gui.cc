@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <sstream>
@@ -30,8 +31,8 @@
 #include <QTreeWidget>
 #include <QWhatsThis>
 #include <QFile>
-#include <QDomDocument>
 #include <QXmlStreamWriter>
+#include <QDBusConnection>
 
 #include <kactioncollection.h>
 #include <kmessagebox.h>
@@ -45,12 +46,20 @@
 #include <KStandardAction>
 #include <KAction>
 #include <KToggleAction>
+#include <KSelectAction>
+#include <KTabWidget>
 #include <KFileDialog>
 #include <KHelpMenu>
 #include <KStandardDirs>
+#include <KConfigGroup>
+#include <KInputDialog>
+#include <KDialog>
 
 #include "rrd_interface.h"
+#include "livefeed.h"
 #include "graph.h"
+#include "session.h"
+#include "memory.h"
 #include "gui.moc"
 
 #include "drag_pixmap.xpm"
@@ -59,6 +68,9 @@
 # define RRD_BASEDIR "/var/lib/collectd/rrd"
 #endif
 
+// default udp-port of collectd's network-plugin
+static const int collectd_port = 25826;
+
 static struct {
   KStandardAction::StandardAction actionType;
   const char *name;
@@ -81,12 +93,31 @@ static struct {
   { I18N_NOOP("Last Week"),        "lastWeek",   SLOT(last_week()) },
   { I18N_NOOP("Last Month"),       "lastMonth",  SLOT(last_month()) },
   { I18N_NOOP("Add New Subgraph"), "splitGraph", SLOT(splitGraph()) },
+  { I18N_NOOP("New Tab"),          "newTab",     SLOT(newTab()) },
+  { I18N_NOOP("Close Tab"),        "closeTab",   SLOT(closeTab()) },
+  { I18N_NOOP("Rename Tab..."),    "renameTab",  SLOT(renameTab()) },
+  { I18N_NOOP("Reload Datasource Tree"), "reloadTree", SLOT(reloadTree()) },
+  { I18N_NOOP("Set Update Interval..."), "updateInterval", 
+    SLOT(setUpdateInterval()) },
+  { I18N_NOOP("Save Snapshot..."), "saveSnapshot", SLOT(saveSnapshot()) },
+  { I18N_NOOP("Memory Usage..."),  "memoryUsage", SLOT(showMemory()) },
+};
+
+// offsets of the time-shift overlay, a custom one asked for last
+static const struct {
+  const char *label;
+  time_t offset;
+} time_shifts[] = {
+  { I18N_NOOP("Nothing"),                0 },
+  { I18N_NOOP("Same Time Yesterday"),    3600*24 },
+  { I18N_NOOP("Same Time Last Week"),    3600*24*7 },
+  { I18N_NOOP("Custom Offset..."),       -1 },
 };
 
 static const std::string delimiter("•");
 
 static void get_datasources(const std::string &rrdfile, const std::string &info,
-      QTreeWidgetItem *item)
+      const std::string &path, QTreeWidgetItem *item, SensorCatalog &catalog)
 {
   std::set<std::string> datasources;
   get_dsinfo(rrdfile, datasources);
@@ -96,6 +127,7 @@ static void get_datasources(const std::string &rrdfile, const std::string &info,
     item->setText(1, QString::fromUtf8(info.c_str()));
     item->setText(2, QString::fromUtf8(rrdfile.c_str()));
     item->setText(3, QString::fromUtf8((*datasources.begin()).c_str()));
+    catalog.add(path, item->text(2), item->text(3), item->text(1));
   } else { 
     for(std::set<std::string>::iterator i=datasources.begin();
 	i != datasources.end(); ++i){
@@ -105,6 +137,7 @@ static void get_datasources(const std::string &rrdfile, const std::string &info,
       SL.append(QString::fromUtf8(i->c_str()));
       QTreeWidgetItem *dsitem = new QTreeWidgetItem(item, SL);
       item->setFlags(dsitem->flags() & ~Qt::ItemIsSelectable);
+      catalog.add(path, SL[2], SL[3], SL[1]);
    }
   }
 }
@@ -120,7 +153,7 @@ static QTreeWidgetItem *mkItem(QTreeWidgetItem *item, std::string s)
 }
 
 static void get_rrds(const boost::filesystem::path rrdpath, 
-      QTreeWidget *listview)
+      QTreeWidget *listview, SensorCatalog &catalog)
 {
   using namespace boost::filesystem;
   
@@ -141,7 +174,10 @@ static void get_rrds(const boost::filesystem::path rrdpath,
 	      info << host->leaf() << delimiter
 		   << sensor->leaf() << delimiter
 		   << basename(*rrd);
-	      get_datasources(rrd->string(), info.str(), rrditem);
+	      const std::string path = host->leaf() + "/" + sensor->leaf() 
+		+ "/" + rrd->leaf();
+	      get_datasources(rrd->string(), info.str(), path, rrditem, 
+		    catalog);
 	    }
 	  }
 	}
@@ -157,7 +193,8 @@ static void get_rrds(const boost::filesystem::path rrdpath,
  * @param parent parent-widget see KMainWindow
  */
 KCollectdGui::KCollectdGui(QWidget *parent)
-  : KMainWindow(parent), action_collection(parent)
+  : KMainWindow(parent), graph(0), evicted(0), live_feed(0), 
+    action_collection(parent)
 {
   // standard_actions
   for (size_t i=0; i< sizeof(standard_actions)/sizeof(*standard_actions); ++i)
@@ -182,6 +219,40 @@ KCollectdGui::KCollectdGui(QWidget *parent)
   actionCollection()->addAction("hideTree", panel_action);
   connect(panel_action, SIGNAL(toggled(bool)), this, SLOT(hideTree(bool)));
 
+  perf_action = new KAction(i18n("Show Performance Counters"), this);
+  perf_action->setCheckable(true);
+  actionCollection()->addAction("perfOverlay", perf_action);
+  connect(perf_action, SIGNAL(toggled(bool)), this, SLOT(perfOverlay(bool)));
+
+  live_action = new KAction(i18n("Live Values from Network"), this);
+  live_action->setCheckable(true);
+  actionCollection()->addAction("liveFeed", live_action);
+  connect(live_action, SIGNAL(toggled(bool)), this, SLOT(liveFeed(bool)));
+
+  gl_action = new KAction(i18n("Render with OpenGL"), this);
+  gl_action->setCheckable(true);
+  gl_action->setEnabled(Graph::openGLAvailable());
+  actionCollection()->addAction("openGL", gl_action);
+
+  aa_action = new KAction(i18n("Smooth Lines"), this);
+  aa_action->setCheckable(true);
+  actionCollection()->addAction("antialias", aa_action);
+
+  stats_action = new KAction(i18n("Statistics in Legend"), this);
+  stats_action->setCheckable(true);
+  actionCollection()->addAction("legendStats", stats_action);
+
+  cross_action = new KAction(i18n("Crosshair"), this);
+  cross_action->setCheckable(true);
+  actionCollection()->addAction("crosshair", cross_action);
+
+  shift_action = new KSelectAction(i18n("Compare With"), this);
+  for (size_t i=0; i< sizeof(time_shifts)/sizeof(*time_shifts); ++i)
+    shift_action->addAction(i18n(time_shifts[i].label));
+  shift_action->setCurrentItem(0);
+  actionCollection()->addAction("timeShift", shift_action);
+  connect(shift_action, SIGNAL(triggered(int)), this, SLOT(timeShift(int)));
+
   // build widgets
   QWidget *main_widget = new QWidget(this);
   setCentralWidget(main_widget);
@@ -196,8 +267,28 @@ KCollectdGui::KCollectdGui(QWidget *parent)
 
   vbox = new QVBoxLayout;
   hbox->addLayout(vbox);
-  graph = new Graph;
-  vbox->addWidget(graph);
+  tabs = new KTabWidget;
+  tabs->setCloseButtonEnabled(true);
+  tabs->setTabBarHidden(true);
+  vbox->addWidget(tabs);
+  gl_action->setChecked(Graph::openGLAvailable() 
+	&& KGlobal::config()->group("Graph").readEntry("opengl", false));
+  connect(gl_action, SIGNAL(toggled(bool)), this, SLOT(openGL(bool)));
+  aa_action->setChecked(KGlobal::config()->group("Graph")
+	.readEntry("antialias", true));
+  connect(aa_action, SIGNAL(toggled(bool)), this, SLOT(antialias(bool)));
+  stats_action->setChecked(KGlobal::config()->group("Graph")
+	.readEntry("legend-stats", true));
+  connect(stats_action, SIGNAL(toggled(bool)), 
+	this, SLOT(legendStats(bool)));
+  cross_action->setChecked(KGlobal::config()->group("Graph")
+	.readEntry("crosshair", true));
+  connect(cross_action, SIGNAL(toggled(bool)), this, SLOT(crosshair(bool)));
+  // samples of all tabs kept in MiB
+  memory_budget = size_t(KGlobal::config()->group("Graph")
+	.readEntry("memory-budget", 256)) << 20;
+  pack_suspended = KGlobal::config()->group("Graph")
+	.readEntry("pack-suspended", true);
 
   QHBoxLayout *hbox2 = new QHBoxLayout;
   vbox->addLayout(hbox2);
@@ -223,7 +314,7 @@ KCollectdGui::KCollectdGui(QWidget *parent)
   QString text = i18n("<p>This button toggles the "
 	"automatic update-and-follow mode</p>"
 	"<p>The automatic update-and-follow mode updates the graph "
-	"every ten seconds. "
+	"in the interval set in the view-menu (ten seconds by default). "
 	"In this mode the graph still can be zoomed, but always displays "
 	"<i>now</i> near the right edge and "
 	"can not be scrolled any more.<br />"
@@ -244,18 +335,27 @@ KCollectdGui::KCollectdGui(QWidget *parent)
   connect(zoom_in,     SIGNAL(clicked()), this, SLOT(zoomIn()));
   connect(zoom_out,    SIGNAL(clicked()), this, SLOT(zoomOut()));
   connect(auto_button, SIGNAL(toggled(bool)), this, SLOT(autoUpdate(bool)));
+  connect(tabs, SIGNAL(currentChanged(int)), this, SLOT(switchTab(int)));
+  connect(tabs, SIGNAL(closeRequest(QWidget *)), 
+	this, SLOT(closeTab(QWidget *)));
 
   // Menu
   KMenu *fileMenu = new KMenu(i18n("&File"));
   menuBar()->addMenu(fileMenu);
   fileMenu->addAction(actionCollection()->action("open"));
   fileMenu->addAction(actionCollection()->action("save"));
+  fileMenu->addAction(actionCollection()->action("saveSnapshot"));
+  fileMenu->addSeparator();
+  fileMenu->addAction(actionCollection()->action("newTab"));
+  fileMenu->addAction(actionCollection()->action("closeTab"));
   fileMenu->addSeparator();
   fileMenu->addAction(actionCollection()->action("quit"));
   
   KMenu *editMenu = new KMenu(i18n("&Edit"));
   menuBar()->addMenu(editMenu);
   editMenu->addAction(actionCollection()->action("splitGraph"));
+  editMenu->addAction(actionCollection()->action("renameTab"));
+  editMenu->addAction(actionCollection()->action("reloadTree"));
 
   KMenu *viewMenu = new KMenu(i18n("&View"));
   menuBar()->addMenu(viewMenu);
@@ -268,17 +368,29 @@ KCollectdGui::KCollectdGui(QWidget *parent)
   viewMenu->addAction(actionCollection()->action("lastMonth"));
   viewMenu->addSeparator();
   viewMenu->addAction(actionCollection()->action("autoUpdate"));
+  viewMenu->addAction(actionCollection()->action("updateInterval"));
+  viewMenu->addAction(actionCollection()->action("liveFeed"));
+  viewMenu->addAction(actionCollection()->action("timeShift"));
   viewMenu->addSeparator();
   viewMenu->addAction(actionCollection()->action("hideTree"));
+  viewMenu->addAction(actionCollection()->action("perfOverlay"));
+  viewMenu->addAction(actionCollection()->action("memoryUsage"));
+  viewMenu->addAction(actionCollection()->action("openGL"));
+  viewMenu->addAction(actionCollection()->action("antialias"));
+  viewMenu->addAction(actionCollection()->action("legendStats"));
+  viewMenu->addAction(actionCollection()->action("crosshair"));
 
   menuBar()->addMenu(helpMenu());
 
+  addTab(QString());
+
   // build rrd-tree
-  get_rrds(RRD_BASEDIR, listview());
+  get_rrds(RRD_BASEDIR, listview(), catalog);
 }
 
 KCollectdGui::~KCollectdGui()
 {
+  liveFeed(false);
 }
 
 void KCollectdGui::startDrag(QTreeWidgetItem *widget, int col)
@@ -299,13 +411,265 @@ void KCollectdGui::startDrag(QTreeWidgetItem *widget, int col)
   drag->exec();
 }
 
+/**
+ * replace the graph of the current tab by @a new_graph
+ */
 void KCollectdGui::set(Graph *new_graph)
 {
+  const int index = tabs->currentIndex();
+  const QString label = tabs->tabText(index);
+  Graph *old = graph;
+  QDBusConnection::sessionBus().unregisterObject("/Graph");
+  if (live_feed)
+    old->live(0);
+  graph = 0;
+  recent.erase(std::remove(recent.begin(), recent.end(), old), recent.end());
+  tabs->removeTab(index);
+  new_graph->suspend(true);
+  tabs->insertTab(index, new_graph, label);
+  tabs->setCurrentIndex(index);
+  delete old;
+}
+
+/**
+ * the graph of tab @a index
+ */
+Graph *KCollectdGui::tab(int index) const
+{
+  return qobject_cast<Graph *>(tabs->widget(index));
+}
+
+/**
+ * number of tabs
+ */
+int KCollectdGui::tabCount() const
+{
+  return tabs->count();
+}
+
+/**
+ * add a tab with an empty graph behind the others and show it
+ */
+Graph *KCollectdGui::addTab(const QString &label)
+{
+  return addTab(new Graph, label);
+}
+
+/**
+ * add a tab with @a g behind the others and show it, the tab takes
+ * ownership of @a g
+ */
+Graph *KCollectdGui::addTab(Graph *g, const QString &label)
+{
+  g->openGL(gl_action->isChecked());
+  g->antialias(aa_action->isChecked());
+  g->legendStats(stats_action->isChecked());
+  g->crosshair(cross_action->isChecked());
+  g->perfOverlay(perf_action->isChecked());
+  g->packSuspended(pack_suspended);
+  g->suspend(true);
+  connect(g, SIGNAL(dataFetched()), this, SLOT(trimMemory()));
+  const int index = tabs->addTab(g, label.isEmpty() 
+	? i18n("Graph %1", tabs->count() + 1) : label);
+  tabs->setTabBarHidden(tabs->count() < 2);
+  tabs->setCurrentIndex(index);
+  return g;
+}
+
+/**
+ * remove all tabs and their graphs
+ */
+void KCollectdGui::removeTabs()
+{
+  if (graph && live_feed)
+    graph->live(0);
+  QDBusConnection::sessionBus().unregisterObject("/Graph");
+  graph = 0;
+  recent.clear();
+  while (tabs->count()) {
+    QWidget *w = tabs->widget(0);
+    tabs->removeTab(0);
+    delete w;
+  }
+}
+
+/**
+ * show the graph of tab @a index, suspending the one shown before
+ *
+ * only the shown graph fetches and renders; background tabs keep
+ * their data until it is evicted by trimMemory().
+ */
+void KCollectdGui::switchTab(int index)
+{
+  Graph *next = tab(index);
+  if (!next || next == graph)
+    return;
+
+  QDBusConnection::sessionBus().unregisterObject("/Graph");
   if (graph) {
-    vbox->removeWidget(graph);
-    delete graph;
+    if (live_feed)
+      graph->live(0);
+    graph->suspend(true);
+  }
+  graph = next;
+  graph->suspend(false);
+  if (live_feed)
+    graph->live(live_feed);
+  QDBusConnection::sessionBus().registerObject("/Graph", graph, 
+	QDBusConnection::ExportScriptableSlots);
+  recent.erase(std::remove(recent.begin(), recent.end(), graph), recent.end());
+  recent.push_back(graph);
+
+  auto_button->setChecked(graph->autoUpdate());
+  auto_action->setChecked(graph->autoUpdate());
+  showTimeShift();
+  trimMemory();
+}
+
+/**
+ * evict the least recently drawn series of background tabs until the
+ * samples of all tabs fit into memory_budget
+ */
+void KCollectdGui::trimMemory()
+{
+  evicted += trim_series(recent, memory_budget);
+}
+
+/**
+ * show the bytes held per series, per subgraph, per tab and in total
+ */
+void KCollectdGui::showMemory()
+{
+  KDialog dialog(this);
+  dialog.setCaption(i18n("Memory Usage"));
+  dialog.setButtons(KDialog::Close);
+
+  QTreeWidget *tree = new QTreeWidget;
+  tree->setColumnCount(3);
+  tree->setHeaderLabels(QStringList() << i18n("Series") << i18n("Samples") 
+	<< i18n("Bytes"));
+  const KLocale *locale = KGlobal::locale();
+  size_t total = 0, sample_bytes = 0;
+  for(int n=0; n<tabs->count(); ++n) {
+    Graph *g = tab(n);
+    QTreeWidgetItem *tab_item = new QTreeWidgetItem(tree, 
+	  QStringList(tabs->tabText(n)));
+    size_t tab_bytes = 0;
+    int number = 1;
+    for(Graph::const_iterator i = g->begin(); i != g->end(); ++i, ++number) {
+      QTreeWidgetItem *sub_item = new QTreeWidgetItem(tab_item, 
+	    QStringList(i18n("Subgraph %1", number)));
+      size_t sub_bytes = 0;
+      for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j) {
+	const size_t bytes = series_bytes(*j);
+	size_t samples = j->avg_data.size() + j->min_data.size() 
+	  + j->max_data.size() + j->shift_data.size();
+	for(int k=0; k<4; ++k)
+	  samples += j->packed[k].size();
+	QStringList columns(j->label.isEmpty() 
+	      ? QString("%1:%2").arg(j->rrd, j->ds) : j->label);
+	columns << (j->fetched ? locale->formatNumber(double(samples), 0) 
+	      : i18n("evicted")) << locale->formatByteSize(bytes);
+	new QTreeWidgetItem(sub_item, columns);
+	sub_bytes += bytes;
+      }
+      sub_item->setText(2, locale->formatByteSize(sub_bytes));
+      tab_bytes += sub_bytes;
+    }
+    const size_t images = g->memoryUsage() - tab_bytes;
+    QStringList columns(i18n("Panel images"));
+    columns << QString() << locale->formatByteSize(images);
+    new QTreeWidgetItem(tab_item, columns);
+    tab_item->setText(2, locale->formatByteSize(tab_bytes + images));
+    total += tab_bytes + images;
+    sample_bytes += tab_bytes;
+  }
+  tree->expandAll();
+  tree->resizeColumnToContents(0);
+
+  QWidget *main = new QWidget;
+  QVBoxLayout *layout = new QVBoxLayout(main);
+  layout->addWidget(tree);
+  layout->addWidget(new QLabel(i18n("Total %1 of a budget of %2 for "
+		"samples, %3 evicted so far", 
+		locale->formatByteSize(total), 
+		locale->formatByteSize(memory_budget), 
+		locale->formatByteSize(evicted))));
+  if (sample_bytes > memory_budget)
+    layout->addWidget(new QLabel(i18n("The budget is exceeded by %1, the "
+		  "samples of the shown graph are never evicted.", 
+		  locale->formatByteSize(sample_bytes - memory_budget))));
+  dialog.setMainWidget(main);
+  dialog.resize(500, 400);
+  dialog.exec();
+}
+
+void KCollectdGui::newTab()
+{
+  addTab(QString());
+}
+
+void KCollectdGui::closeTab()
+{
+  closeTab(graph);
+}
+
+/**
+ * close the tab of @a w, the last tab is replaced by an empty one
+ */
+void KCollectdGui::closeTab(QWidget *w)
+{
+  const int index = tabs->indexOf(w);
+  if (index < 0)
+    return;
+  if (tabs->count() == 1)
+    addTab(QString());
+
+  if (w == graph) {
+    QDBusConnection::sessionBus().unregisterObject("/Graph");
+    if (live_feed)
+      graph->live(0);
+    graph = 0;
   }
-  vbox->insertWidget(0, new_graph);
+  recent.erase(std::remove(recent.begin(), recent.end(), w), recent.end());
+  tabs->removeTab(index);
+  w->deleteLater();
+  tabs->setTabBarHidden(tabs->count() < 2);
+  if (!graph)
+    switchTab(tabs->currentIndex());
+  graph->changed(true);
+}
+
+/**
+ * ask for a new label of the current tab
+ */
+void KCollectdGui::renameTab()
+{
+  bool ok;
+  const int index = tabs->currentIndex();
+  const QString label = KInputDialog::getText(i18n("Rename Tab"), 
+	i18n("Label of the tab:"), tabs->tabText(index), &ok, this);
+  if (ok && !label.isEmpty()) {
+    tabs->setTabText(index, label);
+    graph->changed(true);
+  }
+}
+
+/**
+ * true if any tab changed since it was loaded or saved
+ */
+bool KCollectdGui::tabsChanged() const
+{
+  for(int i=0; i<tabs->count(); ++i)
+    if (tab(i)->changed())
+      return true;
+  return false;
+}
+
+void KCollectdGui::tabsChanged(bool c)
+{
+  for(int i=0; i<tabs->count(); ++i)
+    tab(i)->changed(c);
 }
 
 void KCollectdGui::autoUpdate(bool t)
@@ -320,6 +684,150 @@ void KCollectdGui::hideTree(bool t)
   listview_->setHidden(t);
 }
 
+void KCollectdGui::perfOverlay(bool t)
+{
+  for(int i=0; i<tabs->count(); ++i)
+    tab(i)->perfOverlay(t);
+}
+
+/**
+ * receive values from collectd's network-plugin and draw them on top
+ * of the rrd-data. The port is read from the group "Live" of the
+ * config-file.
+ */
+void KCollectdGui::liveFeed(bool t)
+{
+  if (t && !live_feed) {
+    const int port = KGlobal::config()->group("Live")
+      .readEntry("port", collectd_port);
+    live_feed = new LiveFeed(RRD_BASEDIR);
+    if (live_feed->listen(port)) {
+      graph->live(live_feed);
+    } else {
+      KMessageBox::detailedSorry(this, 
+	    i18n("listening on udp-port %1 failed.", port),
+	    i18n("System message is: ‘%1’", live_feed->errorString()));
+      delete live_feed;
+      live_feed = 0;
+      live_action->setChecked(false);
+    }
+  } else if (!t && live_feed) {
+    graph->live(0);
+    delete live_feed;
+    live_feed = 0;
+  }
+}
+
+/**
+ * switch between OpenGL and QPainter for drawing the graphs. The
+ * choice is remembered in the group "Graph" of the config-file.
+ */
+void KCollectdGui::openGL(bool t)
+{
+  if (graph->openGL(t) != t) {
+    gl_action->setChecked(false);
+    KMessageBox::sorry(this, i18n("OpenGL is not available, "
+	  "graphs are drawn without it."));
+    return;
+  }
+  for(int i=0; i<tabs->count(); ++i)
+    tab(i)->openGL(t);
+  KGlobal::config()->group("Graph").writeEntry("opengl", t);
+}
+
+/**
+ * switch antialiased drawing without OpenGL on or off
+ */
+void KCollectdGui::antialias(bool t)
+{
+  for(int i=0; i<tabs->count(); ++i)
+    tab(i)->antialias(t);
+  KGlobal::config()->group("Graph").writeEntry("antialias", t);
+}
+
+/**
+ * switch min/avg/max/p95/last in the legend on or off
+ */
+void KCollectdGui::legendStats(bool t)
+{
+  for(int i=0; i<tabs->count(); ++i)
+    tab(i)->legendStats(t);
+  KGlobal::config()->group("Graph").writeEntry("legend-stats", t);
+}
+
+/**
+ * switch the crosshair with the values under the mouse on or off
+ */
+void KCollectdGui::crosshair(bool t)
+{
+  for(int i=0; i<tabs->count(); ++i)
+    tab(i)->crosshair(t);
+  KGlobal::config()->group("Graph").writeEntry("crosshair", t);
+}
+
+/**
+ * overlay the graph with the series @a index of time_shifts earlier,
+ * asking for the offset of the custom one
+ */
+void KCollectdGui::timeShift(int index)
+{
+  time_t offset = time_shifts[index].offset;
+  if (offset < 0) {
+    bool ok;
+    const int hours = KInputDialog::getInteger(i18n("Compare With"), 
+	  i18n("Hours earlier:"), graph->timeShift() ? graph->timeShift() / 3600 
+	  : 24, 1, 24*366, 1, &ok, this);
+    offset = ok ? hours * 3600 : graph->timeShift();
+  }
+  graph->timeShift(offset);
+  showTimeShift();
+}
+
+/**
+ * select the entry of the graphs time-shift in the menu
+ */
+void KCollectdGui::showTimeShift()
+{
+  const int n = sizeof(time_shifts)/sizeof(*time_shifts);
+  int i = 0;
+  while (i < n-1 && time_shifts[i].offset != graph->timeShift())
+    ++i;
+  shift_action->setCurrentItem(i);
+}
+
+/**
+ * ask for the auto-update interval in seconds
+ */
+void KCollectdGui::setUpdateInterval()
+{
+  bool ok;
+  double seconds = KInputDialog::getDouble(i18n("Update Interval"), 
+	i18n("Seconds between automatic updates:"), 
+	graph->updateInterval() / 1000.0, 0.1, 3600, 1, &ok, this);
+  if (ok) {
+    graph->updateInterval(int(seconds * 1000));
+    graph->changed(true);
+  }
+}
+
+/**
+ * rescan the rrd-basedir and reexpand wildcard-plots
+ */
+void KCollectdGui::reloadTree()
+{
+  listview_->clear();
+  catalog.clear();
+  try {
+    get_rrds(RRD_BASEDIR, listview(), catalog);
+  } 
+  catch(boost::filesystem::basic_filesystem_error<boost::filesystem::path> &e) {
+    KMessageBox::error(this, i18n("Failed to read collectd-structure at "
+		"\'%1\'", QString(RRD_BASEDIR)));
+  }
+  for(int i=0; i<tabs->count(); ++i)
+    tab(i)->expandWildcards(catalog);
+}
+
 void KCollectdGui::load()
 {
   QString file = KFileDialog::getOpenFileName(KUrl(), 
@@ -348,38 +856,105 @@ void KCollectdGui::save()
   save(file);
 }
 
-void KCollectdGui::load(const QString &file)
+/**
+ * save the session together with the data it shows
+ */
+void KCollectdGui::saveSnapshot()
 {
-  QFile in(file);
-  if (in.open(QIODevice::ReadOnly)) {
-    QDomDocument doc;
-    doc.setContent(&in);
-    
-    graph->clear();
-    
-    QDomElement t = doc.documentElement().firstChildElement("tab");
-    while(!t.isNull()) {
-      QDomElement g = t.firstChildElement("graph");
-      while(!g.isNull()) {
-	GraphInfo &graphinfo = graph->add();
-	QDomElement p = g.firstChildElement("plot");
-	while(!p.isNull()) {
-	  graphinfo.add(p.attribute("rrd"), p.attribute("ds"), p.attribute("label"));
-	  p = p.nextSiblingElement();
-	}
-	g = g.nextSiblingElement();
-      }
-      t = t.nextSiblingElement();
+  QString file = KFileDialog::getSaveFileName(KUrl(), 
+	"application/x-kcollectd", this);
+  if (file.isEmpty()) return;
+
+  if (QFile::exists(file)) {
+    int answer = KMessageBox::questionYesNo(this, 
+	  i18n("file ‘%1’ allready exists.\n"
+		"Do you want to overwrite it?", file));
+    if (answer != KMessageBox::Yes) {
+      return;
     }
+  }
+
+  QString error;
+  if (SessionFile::write(file, *graph, &error)) {
     filename = file;
     graph->changed(false);
   } else {
     KMessageBox::detailedSorry(this, 
-	  i18n("reading file ‘%1’ failed.", filename), 
-	  i18n("System message is: ‘%1’", in.errorString()));
+	  i18n("opening the file ‘%1’ for writing failed.", file), 
+	  i18n("System message is: ‘%1’", error));
   }
 }
 
+void KCollectdGui::load(const QString &file)
+{
+  std::vector<session_tab> loaded;
+  QString error;
+  if (!read_session(file, loaded, &error)) {
+    KMessageBox::detailedSorry(this, 
+	  i18n("reading file ‘%1’ failed.", file), 
+	  i18n("System message is: ‘%1’", error));
+    return;
+  }
+
+  removeTabs();
+  for(size_t i=0; i<loaded.size(); ++i)
+    addTab(loaded[i].graph, loaded[i].label)->expandWildcards(catalog);
+  tabs->setCurrentIndex(0);
+  showTimeShift();
+  filename = file;
+  tabsChanged(false);
+}
+
+/**
+ * write @a graph as a tab labeled @a label
+ */
+static void write_tab(QXmlStreamWriter &stream, const Graph &graph, 
+      const QString &label)
+{
+  stream.writeStartElement("tab");
+  stream.writeAttribute("label", label);
+  stream.writeAttribute("update-interval", 
+	QString::number(graph.updateInterval()));
+  if (graph.timeShift())
+    stream.writeAttribute("time-shift", 
+	  QString::number(qint64(graph.timeShift())));
+  for(Graph::const_iterator i = graph.begin(); i != graph.end(); ++i) {
+    stream.writeStartElement("graph");
+    for(std::vector<GraphInfo::wildcard>::const_iterator w 
+	  = i->wildcards().begin(); w != i->wildcards().end(); ++w) {
+      stream.writeStartElement("plot");
+      stream.writeAttribute("rrd", w->rrd);
+      stream.writeAttribute("ds", w->ds);
+      stream.writeAttribute("label", w->label);
+      stream.writeEndElement();
+    }
+    for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j) {
+      if (j->generated) continue;
+      stream.writeStartElement("plot");
+      if (j->aggregate != agg_none) {
+	stream.writeAttribute("label", j->label);
+	stream.writeAttribute("aggregate", aggregate_name(j->aggregate));
+	if (j->aggregate == agg_quantile || j->aggregate == agg_band)
+	  stream.writeAttribute("quantile", QString::number(j->quantile));
+	for(std::vector<rrd_source>::const_iterator m = j->members.begin();
+	    m != j->members.end(); ++m) {
+	  stream.writeStartElement("member");
+	  stream.writeAttribute("rrd", QString::fromUtf8(m->file.c_str()));
+	  stream.writeAttribute("ds", QString::fromUtf8(m->ds.c_str()));
+	  stream.writeEndElement();
+	}
+      } else {
+	stream.writeAttribute("rrd", j->rrd);
+	stream.writeAttribute("ds", j->ds);
+	stream.writeAttribute("label", j->label);
+      }
+      stream.writeEndElement();
+    }
+    stream.writeEndElement();
+  }
+  stream.writeEndElement();
+}
+
 void KCollectdGui::save(const QString &file)
 {
   QFile out(file);
@@ -391,24 +966,15 @@ void KCollectdGui::save(const QString &file)
 	  "\"/usr/share/kcollectd/kcollectd.xsd\">");
     
     stream.writeStartElement("kcollectd");
-    stream.writeStartElement("tab");
-    for(Graph::const_iterator i = graph->begin(); i != graph->end(); ++i) {
-      stream.writeStartElement("graph");
-      for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j) {
-	stream.writeStartElement("plot");
-	stream.writeAttribute("rrd", j->rrd);
-	stream.writeAttribute("ds", j->ds);
-	stream.writeAttribute("label", j->label);
-	stream.writeEndElement();
-      }
-      stream.writeEndElement();
-    }
-    stream.writeEndElement();
+    stream.writeAttribute("update-interval", 
+	  QString::number(graph->updateInterval()));
+    for(int n=0; n<tabs->count(); ++n)
+      write_tab(stream, *tab(n), tabs->tabText(n));
     stream.writeEndElement();
     
     stream.writeEndDocument();
     filename = file;
-    graph->changed(false);
+    tabsChanged(false);
   } else {
     KMessageBox::detailedSorry(this, 
 	  i18n("opening the file ‘%1’ for writing failed.", filename), 
@@ -421,7 +987,8 @@ void KCollectdGui::saveProperties(KConfigGroup &conf)
   conf.writeEntry("hide-navigation", listview_->isHidden());
   conf.writeEntry("auto-update", graph->autoUpdate());
   conf.writeEntry("range", qint64(graph->range()));
-  if (!graph->changed() && !filename.isEmpty()) {
+  conf.writeEntry("update-interval", graph->updateInterval());
+  if (!tabsChanged() && !filename.isEmpty()) {
     conf.writeEntry("filename", QDir().absoluteFilePath(filename));
     conf.writeEntry("file-is-session", false);
   } else {
@@ -442,6 +1009,7 @@ void KCollectdGui::readProperties(const KConfigGroup &conf)
   bool nav = conf.readEntry("hide-navigation", false);
   bool aut = conf.readEntry("auto-update", false);
   time_t range = conf.readEntry("range", 24*3600);
+  int interval = conf.readEntry("update-interval", 10000);
   QString file = conf.readEntry("filename", QString());
   bool file_is_session = conf.readEntry("file-is-session", false);
   if (!file.isEmpty()) {
@@ -454,6 +1022,7 @@ void KCollectdGui::readProperties(const KConfigGroup &conf)
     }
   }
   panel_action->setChecked(nav);
+  graph->updateInterval(interval);
   autoUpdate(aut);
   graph->last(range);
 }
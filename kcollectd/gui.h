@@ -22,17 +22,23 @@
 #ifndef GUI_H
 #define GUI_H
 
+#include <vector>
+
 #include <KMainWindow>
 #include <kactioncollection.h>
 
 #include "graph.h"
+#include "catalog.h"
 
 class QLabel;
 class Graph;
 class QTreeWidget;
 class QVBoxLayout;
 class KAction;
+class KSelectAction;
+class KTabWidget;
 class KPushButton;
+class LiveFeed;
 
 class KCollectdGui : public KMainWindow // QWidget
 {
@@ -43,6 +49,8 @@ public:
 
   QTreeWidget *listview() { return listview_; }
   KActionCollection* actionCollection() { return &action_collection; }
+  Graph *currentGraph() { return graph; }
+  int tabCount() const;
 
   void set(Graph *graph);
   void load(const QString &filename);
@@ -58,21 +66,57 @@ public slots:
   virtual void zoomOut();
   virtual void autoUpdate(bool active);
   virtual void hideTree(bool active);
+  virtual void perfOverlay(bool active);
+  virtual void reloadTree();
+  virtual void liveFeed(bool active);
+  virtual void setUpdateInterval();
+  virtual void openGL(bool active);
+  virtual void antialias(bool active);
+  virtual void legendStats(bool active);
+  virtual void crosshair(bool active);
+  virtual void timeShift(int index);
+  virtual void newTab();
+  virtual void closeTab();
+  virtual void closeTab(QWidget *tab);
+  virtual void renameTab();
+  virtual void switchTab(int index);
+  virtual void showMemory();
   virtual void splitGraph();
   virtual void load();
   virtual void save();
+  virtual void saveSnapshot();
+
+private slots:
+  void trimMemory();
 
 protected:
   virtual void saveProperties(KConfigGroup &);
   virtual void readProperties(const KConfigGroup &);
 
 private:
+  void showTimeShift();
+  Graph *addTab(const QString &label);
+  Graph *addTab(Graph *g, const QString &label);
+  void removeTabs();
+  Graph *tab(int index) const;
+  bool tabsChanged() const;
+  void tabsChanged(bool c);
+
   QTreeWidget *listview_;
   QVBoxLayout *vbox;
-  Graph * graph;
+  KTabWidget *tabs;
+  Graph * graph;		// graph of the current tab
+  std::vector<Graph *> recent;	// tabs, the most recently shown last
+  size_t memory_budget;		// for the samples of all tabs
+  size_t evicted;		// bytes of samples evicted so far
+  bool pack_suspended;		// background tabs keep their series packed
   KPushButton *auto_button;
-  KAction *auto_action, *panel_action;
+  KAction *auto_action, *panel_action, *perf_action, *live_action;
+  KAction *gl_action, *aa_action, *stats_action, *cross_action;
+  KSelectAction *shift_action;
   QString filename;
+  SensorCatalog catalog;
+  LiveFeed *live_feed;
 
   KActionCollection action_collection;
 };
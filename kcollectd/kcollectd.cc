@@ -18,6 +18,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <time.h>
+
 #include <string>
 #include <iostream>
 #include <exception>
@@ -35,6 +38,179 @@
 #include "../config.h"
 
 #include "gui.h"
+#include "graph.h"
+#include "catalog.h"
+#include "session.h"
+#include "export.h"
+#include "compress.h"
+#include "rrd_interface.h"
+#include "replay.h"
+#include "trace.h"
+
+/**
+ * time of a --start/--end argument: seconds since the epoch, or with
+ * a sign relative to now, optionally with a unit s, m, h, d or w
+ */
+static bool parse_time(const QString &arg, time_t now, time_t *result)
+{
+  const std::string s = arg.toStdString();
+  char *tail;
+  long value = strtol(s.c_str(), &tail, 10);
+  if (tail == s.c_str()) return false;
+  switch(*tail) {
+  case 'w': value *= 7;
+  case 'd': value *= 24;
+  case 'h': value *= 60;
+  case 'm': value *= 60;
+  case 's': ++tail;
+  }
+  if (*tail) return false;
+  *result = (s[0] == '-' || s[0] == '+' || value == 0) ? now + value : value;
+  return true;
+}
+
+/**
+ * the time-range of --start and --end
+ */
+static bool parse_range(KCmdLineArgs *args, time_t *start, time_t *end)
+{
+  const time_t now = time(0);
+  if (!parse_time(args->getOption("start"), now, start) 
+	|| !parse_time(args->getOption("end"), now, end) || *end <= *start) {
+    std::cerr << "invalid time-range" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * true if a subgraph of @a graph has wildcard-plots
+ */
+static bool has_wildcards(const Graph &graph)
+{
+  for(Graph::const_iterator g = graph.begin(); g != graph.end(); ++g)
+    if (!g->wildcards().empty())
+      return true;
+  return false;
+}
+
+/**
+ * the plots of all tabs of the file and the --plot arguments
+ *
+ * the file is read without a window, the rrd-basedir is only scanned
+ * if there are wildcard-plots to expand.
+ */
+static bool collect_plots(KCmdLineArgs *args, 
+      std::vector<GraphInfo::datasource> &plots)
+{
+  if (args->count() == 1) {
+    std::vector<session_tab> tabs;
+    QString error;
+    if (!read_session(args->arg(0), tabs, &error)) {
+      std::cerr << "reading " << args->arg(0).toLocal8Bit().data() 
+		<< " failed: " << error.toLocal8Bit().data() << std::endl;
+      return false;
+    }
+    SensorCatalog catalog;
+    bool scanned = false;
+    for(size_t i=0; i<tabs.size(); ++i) {
+      Graph *graph = tabs[i].graph;
+      if (has_wildcards(*graph)) {
+	if (!scanned && !catalog.scan(RRD_BASEDIR))
+	  std::cerr << "reading " << RRD_BASEDIR << " failed, wildcard-plots "
+		    << "are left out" << std::endl;
+	scanned = true;
+	graph->expandWildcards(catalog);
+	graph->expandAll();
+      }
+      for(Graph::const_iterator g = graph->begin(); g != graph->end(); ++g)
+	plots.insert(plots.end(), g->begin(), g->end());
+      delete graph;
+    }
+  }
+  const QStringList specs = args->getOptionList("plot");
+  for(QStringList::const_iterator i = specs.begin(); i != specs.end(); ++i) {
+    const int colon = i->lastIndexOf(':');
+    if (colon <= 0) {
+      std::cerr << "invalid plot " << i->toStdString() 
+		<< ", expected rrd:ds" << std::endl;
+      return false;
+    }
+    GraphInfo::datasource d;
+    d.rrd = i->left(colon);
+    d.ds = i->mid(colon + 1);
+    plots.push_back(d);
+  }
+  if (plots.empty()) {
+    std::cerr << "no plots given" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * the --export mode: write the plots of the file or the --plot
+ * arguments to stdout
+ */
+static int run_export(KCmdLineArgs *args)
+{
+  export_format format;
+  const QString name = args->getOption("export");
+  if (name == "csv")
+    format = export_csv;
+  else if (name == "binary")
+    format = export_binary;
+  else {
+    std::cerr << "unknown export-format " << name.toStdString() << std::endl;
+    return 1;
+  }
+
+  time_t start, end;
+  std::vector<GraphInfo::datasource> plots;
+  if (!parse_range(args, &start, &end) || !collect_plots(args, plots))
+    return 1;
+  const size_t memory = args->getOption("memory").toULong() << 20;
+  return export_data(plots, start, end, format, memory, std::cout);
+}
+
+/**
+ * the --bench-packing mode: compare packed and raw series of the
+ * plots like they are fetched for a graph
+ */
+static int run_bench_packing(KCmdLineArgs *args)
+{
+  time_t start, end;
+  std::vector<GraphInfo::datasource> plots;
+  if (!parse_range(args, &start, &end) || !collect_plots(args, plots))
+    return 1;
+
+  std::vector<std::vector<double> > series(3 * plots.size());
+  std::vector<rrd_request> requests;
+  const char *types[] = { "AVERAGE", "MIN", "MAX" };
+  for(size_t i=0; i<plots.size(); ++i) {
+    if (plots[i].aggregate != agg_none) {
+      time_t s = start, e = end;
+      unsigned long step = 1;
+      get_aggregate_data(plots[i].members, plots[i].aggregate, 
+	    plots[i].quantile, &s, &e, &step, "AVERAGE", &series[3*i]);
+      continue;
+    }
+    for(int t=0; t<3; ++t) {
+      rrd_request r;
+      r.file = plots[i].rrd.toUtf8().data();
+      r.ds = plots[i].ds.toUtf8().data();
+      r.type = types[t];
+      r.start = start;
+      r.end = end;
+      r.step = 1;
+      r.result = &series[3*i + t];
+      requests.push_back(r);
+    }
+  }
+  if (!requests.empty())
+    get_rrd_data(requests, 8);
+  return benchmark_packing(series, std::cout);
+}
 
 int main(int argc, char **argv)
 {
@@ -58,17 +234,62 @@ int main(int argc, char **argv)
 
   KCmdLineOptions options;
   options.add("+[file]", ki18n("A kcollectd-file to open"));
+  options.add("record <file>", 
+	ki18n("Record view-operations into file"));
+  options.add("replay <file>", 
+	ki18n("Replay recorded view-operations offscreen and report "
+	      "frame-times"));
+  options.add("trace <file>", 
+	ki18n("Write a trace of fetches and drawing in Chrome trace-event "
+	      "format to file"));
+  options.add("export <format>", 
+	ki18n("Write the data of file or of the --plot arguments to stdout "
+	      "as csv or binary, without showing a window"));
+  options.add("plot <rrd:ds>", 
+	ki18n("A datasource to export, may be given repeatedly"));
+  options.add("start <time>", 
+	ki18n("Begin of the export, seconds since the epoch or relative "
+	      "to now with unit s, m, h, d or w"), "-1d");
+  options.add("end <time>", ki18n("End of the export"), "0");
+  options.add("bench-packing", 
+	ki18n("Compare packed and raw series of file or of the --plot "
+	      "arguments in decode-speed and size"));
+  options.add("memory <MiB>", 
+	ki18n("Memory to use for the data of one chunk of the export"), "64");
   KCmdLineArgs::addCmdLineOptions( options );
 
   KApplication application;
   KCmdLineArgs *args = KCmdLineArgs::parsedArgs();  
+  if (args->isSet("trace"))
+    Tracer::start(args->getOption("trace").toLocal8Bit().data());
   try {
-    if (application.isSessionRestored()) {
+    if (args->isSet("export")) {
+      int status = run_export(args);
+      Tracer::finish();
+      return status;
+    } else if (args->isSet("bench-packing")) {
+      return run_bench_packing(args);
+    } else if (application.isSessionRestored()) {
       kRestoreMainWindows<KCollectdGui>();
     } else {      
       KCollectdGui *gui = new KCollectdGui;
       // handling arguments
       if(args->count() == 1) gui->load(args->arg(0));
+      if ((args->isSet("replay") || args->isSet("record")) 
+	    && gui->tabCount() > 1) {
+	std::cerr << "--replay and --record need a file with a single tab" 
+		  << std::endl;
+	return 1;
+      }
+      if (args->isSet("replay")) {
+	int status = replay(gui->currentGraph(), args->getOption("replay"), 
+	      QSize(1024, 768), std::cout);
+	Tracer::finish();
+	return status;
+      }
+      if (args->isSet("record"))
+	gui->currentGraph()->recorder(
+	      new ViewRecorder(args->getOption("record")));
       gui->setObjectName("kcollectd#");
       gui->show();
     }
@@ -79,5 +300,8 @@ int main(int argc, char **argv)
     exit(1);
   }
 
-  return application.exec();
+  int status = application.exec();
+  if (!Tracer::finish())
+    std::cerr << "writing trace failed" << std::endl;
+  return status;
 }
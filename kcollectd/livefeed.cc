@@ -0,0 +1,193 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <QMutexLocker>
+
+#include "rrd_interface.h"
+#include "livefeed.h"
+#include "livefeed.moc"
+
+/**
+ * append @a s, returns false if the ring is full
+ */
+bool LiveRing::push(const sample &s)
+{
+  const int h = head.fetchAndAddRelaxed(0);
+  const int next = (h + 1) % capacity;
+  if (next == tail.fetchAndAddAcquire(0))
+    return false;
+  buffer[h] = s;
+  head.fetchAndStoreRelease(next);
+  return true;
+}
+
+/**
+ * take the oldest sample, returns false if the ring is empty
+ */
+bool LiveRing::pop(sample *s)
+{
+  const int t = tail.fetchAndAddRelaxed(0);
+  if (t == head.fetchAndAddAcquire(0))
+    return false;
+  *s = buffer[t];
+  tail.fetchAndStoreRelease((t + 1) % capacity);
+  return true;
+}
+
+/**
+ * @a basedir is the directory collectd writes its rrds into, it is
+ * needed to map filenames to collectd-identifiers.
+ */
+LiveFeed::LiveFeed(const std::string &dir, QObject *parent)
+  : QThread(parent), basedir(dir), fd(-1), running(false)
+{
+  if (!basedir.empty() && basedir[basedir.size()-1] != '/')
+    basedir += '/';
+}
+
+LiveFeed::~LiveFeed()
+{
+  stop();
+  for(sub_map::iterator i = subscriptions.begin(); 
+      i != subscriptions.end(); ++i)
+    for(size_t j=0; j<i->second.size(); ++j)
+      delete i->second[j];
+}
+
+/**
+ * open the udp-socket on @a port (all addresses) and start receiving
+ */
+bool LiveFeed::listen(unsigned short port)
+{
+  fd = socket(AF_INET6, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    error = QString::fromLocal8Bit(strerror(errno));
+    return false;
+  }
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_any;
+  addr.sin6_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    error = QString::fromLocal8Bit(strerror(errno));
+    close(fd);
+    fd = -1;
+    return false;
+  }
+  running = true;
+  start();
+  return true;
+}
+
+void LiveFeed::stop()
+{
+  running = false;
+  wait();
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+/**
+ * ring receiving the values of datasource @a ds in file @a rrd
+ *
+ * rings are owned by the LiveFeed and shared for equal datasources.
+ * Returns 0 if the file is not below the basedir or the datasource
+ * does not exist.
+ */
+LiveRing *LiveFeed::subscribe(const QString &rrd, const QString &ds)
+{
+  const std::pair<QString, QString> key(rrd, ds);
+  std::map<std::pair<QString, QString>, LiveRing *>::iterator k 
+    = known.find(key);
+  if (k != known.end())
+    return k->second;
+
+  LiveRing *result = 0;
+  const std::string file(rrd.toUtf8().data());
+  if (file.compare(0, basedir.size(), basedir) == 0
+	&& file.size() > basedir.size() + 4
+	&& file.compare(file.size() - 4, 4, ".rrd") == 0) {
+    const int index = get_ds_index(file, ds.toUtf8().data());
+    if (index >= 0) {
+      const std::string id = file.substr(basedir.size(), 
+	    file.size() - basedir.size() - 4);
+      subscription *s = new subscription;
+      s->index = index;
+      QMutexLocker locker(&lock);
+      subscriptions[id].push_back(s);
+      result = &s->ring;
+    }
+  }
+  known[key] = result;
+  return result;
+}
+
+/**
+ * called by the parser for every value-list
+ */
+void LiveFeed::received(const collectd_values &vl, void *data)
+{
+  LiveFeed *self = static_cast<LiveFeed *>(data);
+  QMutexLocker locker(&self->lock);
+  sub_map::iterator i = self->subscriptions.find(vl.identifier());
+  if (i == self->subscriptions.end()) 
+    return;
+
+  for(size_t j=0; j<i->second.size(); ++j) {
+    subscription *s = i->second[j];
+    if (s->index >= int(vl.values.size())) 
+      continue;
+    LiveRing::sample sample;
+    sample.time = vl.time;
+    sample.value = s->rate.value(vl, s->index);
+    if (!std::isnan(sample.value))
+      s->ring.push(sample);
+  }
+}
+
+/**
+ * receive-loop, polls with a timeout to notice stop()
+ */
+void LiveFeed::run()
+{
+  char buffer[65536];
+  while (running) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 200) <= 0) 
+      continue;
+    const ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+    if (len > 0)
+      parse_collectd_packet(buffer, len, received, this);
+  }
+}
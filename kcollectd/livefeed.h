@@ -0,0 +1,103 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIVEFEED_H
+#define LIVEFEED_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+#include "netproto.h"
+
+/**
+ * single-producer single-consumer ring of samples
+ *
+ * push() may only be called from one thread and pop() from one other
+ * thread, neither of them blocks. When the ring is full new samples
+ * are dropped.
+ */
+class LiveRing
+{
+public:
+  struct sample {
+    double time;
+    double value;
+  };
+
+  LiveRing() : head(0), tail(0) { }
+  bool push(const sample &s);
+  bool pop(sample *s);
+
+private:
+  enum { capacity = 1024 };
+  sample buffer[capacity];
+  QAtomicInt head;		// next slot to write, owned by producer
+  QAtomicInt tail;		// next slot to read, owned by consumer
+};
+
+/**
+ * receives collectd-network-packets on a udp-port in its own thread
+ * and pushes the values of subscribed datasources into LiveRings
+ */
+class LiveFeed : public QThread
+{
+  Q_OBJECT;
+public:
+  explicit LiveFeed(const std::string &basedir, QObject *parent=0);
+  virtual ~LiveFeed();
+
+  bool listen(unsigned short port);
+  void stop();
+  QString errorString() const { return error; }
+
+  LiveRing *subscribe(const QString &rrd, const QString &ds);
+
+protected:
+  virtual void run();
+
+private:
+  struct subscription {
+    int index;			// index of the ds in the value-list
+    LiveRing ring;
+    collectd_rate rate;
+  };
+  typedef std::map<std::string, std::vector<subscription *> > sub_map;
+
+  static void received(const collectd_values &vl, void *data);
+
+  std::string basedir;
+  int fd;
+  volatile bool running;
+  QString error;
+
+  // guards subscriptions, taken by the receiver for every value-list
+  QMutex lock;
+  sub_map subscriptions;
+  std::map<std::pair<QString, QString>, LiveRing *> known;
+};
+
+#endif
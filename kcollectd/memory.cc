@@ -0,0 +1,113 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "memory.h"
+
+namespace {
+
+/**
+ * a series that may be evicted
+ */
+struct candidate {
+  double drawn;
+  Graph *graph;
+  GraphInfo::datasource *series;
+  size_t bytes;
+
+  bool operator<(const candidate &other) const { 
+    return drawn < other.drawn; 
+  }
+};
+
+size_t vector_bytes(const std::vector<double> &v)
+{
+  return v.capacity() * sizeof(double);
+}
+
+size_t screen_bytes(const screen_series &s)
+{
+  return (s.x.capacity() + s.lo.capacity() + s.hi.capacity() 
+	+ s.scratch.capacity()) * sizeof(float)
+    + (s.runs.capacity() + s.first.capacity()) * sizeof(int);
+}
+
+} // namespace
+
+/**
+ * bytes held by the fetched samples of a datasource and everything
+ * cached from them
+ */
+size_t series_bytes(const GraphInfo::datasource &d)
+{
+  return vector_bytes(d.avg_data) + vector_bytes(d.min_data) 
+    + vector_bytes(d.max_data) + vector_bytes(d.shift_data)
+    + screen_bytes(d.band_screen) + screen_bytes(d.line_screen) 
+    + screen_bytes(d.shift_screen) + d.stats.bytes()
+    + d.packed[0].bytes() + d.packed[1].bytes() + d.packed[2].bytes() 
+    + d.packed[3].bytes();
+}
+
+/**
+ * evict series of suspended @a graphs, least recently drawn first,
+ * until the series of all @a graphs fit into @a budget bytes. Series
+ * of the shown graph are never evicted, if it alone exceeds the budget
+ * only the caches derived from its samples are dropped. Returns the
+ * bytes freed.
+ */
+size_t trim_series(const std::vector<Graph *> &graphs, size_t budget)
+{
+  size_t total = 0;
+  std::vector<candidate> candidates, shown;
+  for(std::vector<Graph *>::const_iterator g = graphs.begin(); 
+      g != graphs.end(); ++g) {
+    for(Graph::iterator i = (*g)->begin(); i != (*g)->end(); ++i) {
+      for(GraphInfo::iterator j = i->begin(); j != i->end(); ++j) {
+	const size_t bytes = series_bytes(*j);
+	total += bytes;
+	if (bytes) {
+	  candidate c = { j->drawn, *g, &*j, bytes };
+	  ((*g)->suspended() ? candidates : shown).push_back(c);
+	}
+      }
+    }
+  }
+  if (total <= budget)
+    return 0;
+
+  std::sort(candidates.begin(), candidates.end());
+  size_t freed = 0;
+  for(std::vector<candidate>::iterator c = candidates.begin(); 
+      c != candidates.end() && total - freed > budget; ++c) {
+    c->graph->release(*c->series);
+    freed += c->bytes;
+  }
+
+  // the samples of the shown graph are needed for the next frame
+  std::sort(shown.begin(), shown.end());
+  for(std::vector<candidate>::iterator c = shown.begin(); 
+      c != shown.end() && total - freed > budget; ++c) {
+    c->graph->dropCaches(*c->series);
+    freed += c->bytes - series_bytes(*c->series);
+  }
+  return freed;
+}
@@ -19,11 +19,13 @@
  */
 
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <string>
-#include <sstream>
-#include <iomanip>
 #include <limits>
 
+#include <time.h>
+
 #include <qstring.h>
 
 #include "misc.h"
@@ -79,11 +81,74 @@ bool si_char(double d, std::string &s, double &m)
  */
 std::string si_number(double d, int p, const std::string &s, double m)
 {
-  std::ostringstream os;
-  os << std::setprecision(p) << d/m;
+  char buffer[32];
+  std::string r(buffer, format_number(d/m, p, buffer));
   if (!s.empty())
-    os << " " << s;
-  return os.str();
+    r += " " + s;
+  return r;
+}
+
+/**
+ * formats @a d like printf("%.*g", p, d) into @a buffer, which must
+ * hold 32 chars, and returns the length.
+ *
+ * numbers as they appear on axes take a path of integer-arithmetic
+ * without allocations, others fall back to snprintf.
+ */
+int format_number(double d, int p, char *buffer)
+{
+  static const double pow10[] = { 
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 
+  };
+
+  if (d == 0) {
+    strcpy(buffer, "0");
+    return 1;
+  }
+  const double a = fabs(d);
+  int e = int(floor(log10(a)));
+  if (p < 1 || p > 15 || e < -4 || e >= p)
+    return snprintf(buffer, 32, "%.*g", p, d);
+
+  // p significant digits as integer n with some decimals
+  int decimals = p - 1 - e;
+  double scaled = a * pow10[decimals];
+  // leave ties to the exact decimal rounding of printf
+  if (fabs(scaled - floor(scaled) - 0.5) < 1e-6)
+    return snprintf(buffer, 32, "%.*g", p, d);
+  if (scaled + 0.5 >= pow10[p]) {
+    // rounds up to the next power of ten
+    if (++e >= p)
+      return snprintf(buffer, 32, "%.*g", p, d);
+    decimals = p - 1 - e;
+    scaled = a * pow10[decimals];
+  }
+  long long n = (long long)(scaled + 0.5);
+  while (decimals > 0 && n % 10 == 0) {
+    n /= 10;
+    --decimals;
+  }
+
+  char digits[24];
+  int len = 0;
+  do {
+    digits[len++] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  while (len <= decimals)
+    digits[len++] = '0';
+
+  char *o = buffer;
+  if (d < 0)
+    *o++ = '-';
+  for(int i = len - 1; i >= 0; --i) {
+    *o++ = digits[i];
+    if (i == decimals && decimals > 0)
+      *o++ = '.';
+  }
+  *o = 0;
+  return o - buffer;
 }
 
 /**
@@ -99,6 +164,45 @@ QString Qstrftime(const char *format, const tm *t)
     return QString();
 }
 
+/**
+ * the label of tick @a t formatted with @a format
+ */
+const QString &label_cache::operator()(const QString &format, time_t t)
+{
+  if (format != format_ || labels.size() > 1000) {
+    format_ = format;
+    labels.clear();
+  }
+  std::map<time_t, QString>::iterator i = labels.find(t);
+  if (i != labels.end())
+    return i->second;
+
+  tm tm;
+  localtime_r(&t, &tm);
+  return labels[t] = Qstrftime(format.toAscii(), &tm);
+}
+
+/**
+ * seconds from an arbitrary but fixed point in time, not affected by
+ * changes of the system-clock. For measuring durations.
+ */
+double monotonic_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * seconds since the epoch with sub-second resolution
+ */
+double wallclock_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 /**
  * determine min and max values for a graph and save it into y_range
  */
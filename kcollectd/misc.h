@@ -22,15 +22,38 @@
 #ifndef LABELING_H
 #define LABELING_H
 
+#include <time.h>
+
+#include <map>
 #include <string>
 #include <vector>
 
+#include <QString>
+
 bool si_char(double d, std::string &s, double &m);
 
 std::string si_number(double d, int p, const std::string &s, double m);
 
+int format_number(double d, int p, char *buffer);
+
 QString Qstrftime(const char *format, const tm *t);
 
+double monotonic_seconds();
+
+/**
+ * strftime-labels of ticks, kept between frames so that only ticks
+ * not seen before get formatted
+ */
+class label_cache {
+public:
+  const QString &operator()(const QString &format, time_t t);
+private:
+  QString format_;
+  std::map<time_t, QString> labels;
+};
+
+double wallclock_seconds();
+
 
 /**
  * linear mapping from range [x1, x2] to range [y1, y2]
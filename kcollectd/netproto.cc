@@ -0,0 +1,203 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <limits>
+
+#include "netproto.h"
+
+// part-types of the collectd network-protocol
+enum {
+  part_host = 0x0000,
+  part_time = 0x0001,
+  part_plugin = 0x0002,
+  part_plugin_instance = 0x0003,
+  part_type = 0x0004,
+  part_type_instance = 0x0005,
+  part_values = 0x0006,
+  part_interval = 0x0007,
+  part_time_hr = 0x0008,
+  part_interval_hr = 0x0009,
+  part_encryption = 0x0210,
+};
+
+static inline unsigned int get_u16(const unsigned char *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static inline unsigned long long get_u64(const unsigned char *p)
+{
+  unsigned long long v = 0;
+  for(int i=0; i<8; ++i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+/**
+ * gauges are sent as little-endian doubles
+ */
+static inline double get_gauge(const unsigned char *p)
+{
+  unsigned long long v = 0;
+  for(int i=7; i>=0; --i)
+    v = (v << 8) | p[i];
+  double d;
+  memcpy(&d, &v, sizeof(d));
+  return d;
+}
+
+/**
+ * identifier like collectd builds the rrd-path:
+ * host/plugin[-instance]/type[-instance]
+ */
+std::string collectd_values::identifier() const
+{
+  std::string id = host + "/" + plugin;
+  if (!plugin_instance.empty())
+    id += "-" + plugin_instance;
+  id += "/" + type;
+  if (!type_instance.empty())
+    id += "-" + type_instance;
+  return id;
+}
+
+/**
+ * parse one packet and call @a callback for every value-list in it
+ *
+ * signatures are skipped, encrypted packets are ignored. Returns
+ * false on malformed packets, value-lists before the error have
+ * already been reported.
+ */
+bool parse_collectd_packet(const char *buffer, size_t size, 
+      collectd_values_cb callback, void *data)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(buffer);
+  const unsigned char *end = p + size;
+  collectd_values vl;
+  vl.time = vl.interval = 0;
+
+  while (end - p >= 4) {
+    const unsigned int type = get_u16(p);
+    const unsigned int length = get_u16(p + 2);
+    if (length < 4 || length > size_t(end - p)) 
+      return false;
+    const unsigned char *body = p + 4;
+    const size_t body_len = length - 4;
+
+    switch(type) {
+    case part_host:
+    case part_plugin:
+    case part_plugin_instance:
+    case part_type:
+    case part_type_instance: {
+      if (body_len == 0 || body[body_len-1] != 0) 
+	return false;
+      const std::string s(reinterpret_cast<const char *>(body));
+      if (type == part_host) vl.host = s;
+      else if (type == part_plugin) vl.plugin = s;
+      else if (type == part_plugin_instance) vl.plugin_instance = s;
+      else if (type == part_type) vl.type = s;
+      else vl.type_instance = s;
+      break; }
+    case part_time:
+    case part_interval:
+    case part_time_hr:
+    case part_interval_hr: {
+      if (body_len != 8) 
+	return false;
+      const unsigned long long v = get_u64(body);
+      const double t = (type == part_time_hr || type == part_interval_hr)
+	? v / 1073741824.0 : double(v);
+      if (type == part_time || type == part_time_hr) vl.time = t;
+      else vl.interval = t;
+      break; }
+    case part_values: {
+      if (body_len < 2) 
+	return false;
+      const size_t n = get_u16(body);
+      if (body_len != 2 + n * 9) 
+	return false;
+      vl.types.resize(n);
+      vl.values.resize(n);
+      const unsigned char *v = body + 2 + n;
+      for(size_t i=0; i<n; ++i, v += 8) {
+	vl.types[i] = collectd_values::ds_type(body[2+i]);
+	switch(vl.types[i]) {
+	case collectd_values::gauge:
+	  vl.values[i] = get_gauge(v);
+	  break;
+	case collectd_values::derive:
+	  vl.values[i] = (long long)get_u64(v);
+	  break;
+	case collectd_values::counter:
+	case collectd_values::absolute:
+	  vl.values[i] = get_u64(v);
+	  break;
+	default:
+	  return false;
+	}
+      }
+      callback(vl, data);
+      break; }
+    case part_encryption:
+      return true;
+    default:
+      // signatures, notifications and unknown parts
+      break;
+    }
+    p += length;
+  }
+  return true;
+}
+
+collectd_rate::collectd_rate() 
+  : last_time(0), last_raw(std::numeric_limits<double>::quiet_NaN())
+{
+}
+
+/**
+ * the rate of value @a index of @a vl, NaN if there is none yet
+ */
+double collectd_rate::value(const collectd_values &vl, size_t index)
+{
+  const double raw = vl.values[index];
+  double result = std::numeric_limits<double>::quiet_NaN();
+  switch(vl.types[index]) {
+  case collectd_values::gauge:
+    result = raw;
+    break;
+  case collectd_values::absolute:
+    if (vl.interval > 0)
+      result = raw / vl.interval;
+    break;
+  case collectd_values::counter:
+  case collectd_values::derive:
+    if (vl.time > last_time)
+      result = (raw - last_raw) / (vl.time - last_time);
+    // counter-wrap or reset
+    if (vl.types[index] == collectd_values::counter && raw < last_raw)
+      result = std::numeric_limits<double>::quiet_NaN();
+    last_raw = raw;
+    last_time = vl.time;
+    break;
+  }
+  return result;
+}
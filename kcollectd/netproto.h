@@ -0,0 +1,59 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETPROTO_H
+#define NETPROTO_H
+
+#include <string>
+#include <vector>
+
+/**
+ * one value-list of collectd's binary network-protocol
+ */
+struct collectd_values {
+  enum ds_type { counter = 0, gauge = 1, derive = 2, absolute = 3 };
+
+  std::string host, plugin, plugin_instance, type, type_instance;
+  double time, interval;
+  std::vector<ds_type> types;
+  std::vector<double> values;
+
+  std::string identifier() const;
+};
+
+typedef void (*collectd_values_cb)(const collectd_values &vl, void *data);
+
+bool parse_collectd_packet(const char *buffer, size_t size, 
+      collectd_values_cb callback, void *data);
+
+/**
+ * turns the values of one datasource into rates like rrdtool does
+ *
+ * counters and derives need the value before, so the first of them
+ * gives NaN.
+ */
+struct collectd_rate {
+  double last_time, last_raw;
+
+  collectd_rate();
+  double value(const collectd_values &vl, size_t index);
+};
+
+#endif
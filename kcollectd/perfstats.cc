@@ -0,0 +1,59 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "perfstats.h"
+
+static const char * const stage_names[PerfStats::stages] = {
+  "fetch", "minmax", "graph", "legend", "total"
+};
+
+void PerfStats::reset()
+{
+  for(int i=0; i<stages; ++i)
+    seconds[i] = 0;
+  rows = points = cache_hits = 0;
+}
+
+/**
+ * add timings and counters of @a other, e.g. of another thread
+ */
+PerfStats &PerfStats::operator+=(const PerfStats &other)
+{
+  for(int i=0; i<stages; ++i)
+    seconds[i] += other.seconds[i];
+  rows += other.rows;
+  points += other.points;
+  cache_hits += other.cache_hits;
+  return *this;
+}
+
+/**
+ * one-line summary, timings in ms
+ */
+QString PerfStats::toString() const
+{
+  QString s;
+  for(int i=0; i<stages; ++i)
+    s += QString("%1 %2ms  ").arg(stage_names[i])
+      .arg(seconds[i] * 1000.0, 0, 'f', 1);
+  s += QString("rows %1  points %2  hits %3")
+    .arg(rows).arg(points).arg(cache_hits);
+  return s;
+}
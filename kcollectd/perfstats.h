@@ -0,0 +1,59 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <QString>
+
+#include "misc.h"
+
+/**
+ * stage-timings and counters of one frame drawn by Graph
+ */
+struct PerfStats {
+  enum stage { fetch, minmax, graph, legend, total, stages };
+
+  double seconds[stages];
+  unsigned long rows;		// rows returned by rrd_fetch
+  unsigned long points;		// points handed to the painter
+  unsigned long cache_hits;	// datasources drawn without fetching
+
+  PerfStats() { reset(); }
+  void reset();
+  PerfStats &operator+=(const PerfStats &other);
+  QString toString() const;
+};
+
+/**
+ * adds the lifetime of the object to one stage of a PerfStats
+ */
+class StageTimer {
+  PerfStats &stats;
+  PerfStats::stage stage;
+  double started;
+public:
+  StageTimer(PerfStats &s, PerfStats::stage st) 
+    : stats(s), stage(st), started(monotonic_seconds()) { }
+  ~StageTimer() { stats.seconds[stage] += monotonic_seconds() - started; }
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "raster.h"
+
+static const float inf = std::numeric_limits<float>::infinity();
+
+/**
+ * multiply all four channels of @a x by @a a / 256
+ */
+static inline quint32 byte_mul(quint32 x, unsigned int a)
+{
+  quint32 t = (((x & 0xff00ff) * a) >> 8) & 0xff00ff;
+  x = ((x >> 8) & 0xff00ff) * a & 0xff00ff00;
+  return x | t;
+}
+
+/**
+ * source-over of premultiplied @a src with coverage @a cov (0..256)
+ */
+static inline void blend(QRgb *dst, quint32 src, unsigned int cov)
+{
+  const quint32 s = byte_mul(src, cov);
+  const unsigned int ia = 255 - qAlpha(s);
+  *dst = s + byte_mul(*dst, ia + (ia >> 7));
+}
+
+/**
+ *
+ */
+Rasterizer::Rasterizer(QImage *image) : 
+  image(image), width(image->width()), height(image->height()),
+  ymin(width), ymax(width)
+{
+  reset();
+}
+
+/**
+ * forget the extents of the last primitive
+ */
+void Rasterizer::reset()
+{
+  std::fill(ymin.begin(), ymin.end(), inf);
+  std::fill(ymax.begin(), ymax.end(), -inf);
+  first = width;
+  last = -1;
+}
+
+/**
+ * grow the per-column extents by the part of the polyline crossing
+ * each column
+ */
+void Rasterizer::extent(const float *x, const float *y, int n)
+{
+  if (n == 1) {
+    const int c = int(floorf(x[0]));
+    if (c >= 0 && c < width) {
+      ymin[c] = std::min(ymin[c], y[0]);
+      ymax[c] = std::max(ymax[c], y[0]);
+      first = std::min(first, c);
+      last = std::max(last, c);
+    }
+    return;
+  }
+
+  for(int i=0; i+1<n; ++i) {
+    const float x0 = x[i], y0 = y[i], x1 = x[i+1], y1 = y[i+1];
+    const float slope = x1 > x0 ? (y1 - y0) / (x1 - x0) : 0;
+    const int begin = std::max(0, int(floorf(x0)));
+    const int end = std::min(width - 1, int(floorf(x1)));
+    for(int c = begin; c <= end; ++c) {
+      // clip the segment to the column
+      const float ya = y0 + (std::max(x0, float(c)) - x0) * slope;
+      const float yb = x1 > x0 ? y0 + (std::min(x1, c + 1.0f) - x0) * slope : y1;
+      ymin[c] = std::min(ymin[c], std::min(ya, yb));
+      ymax[c] = std::max(ymax[c], std::max(ya, yb));
+    }
+    if (begin <= end) {
+      first = std::min(first, begin);
+      last = std::max(last, end);
+    }
+  }
+}
+
+/**
+ * blend the spans of all touched columns, widened by @a grow on both
+ * ends, and reset the extents
+ */
+void Rasterizer::fill(const QColor &color, float grow)
+{
+  const quint32 src = qPremultiply(color.rgba());
+  const int stride = image->bytesPerLine() / sizeof(QRgb);
+  QRgb *bits = reinterpret_cast<QRgb *>(image->bits());
+
+  for(int c = first; c <= last; ++c) {
+    if (ymin[c] > ymax[c])
+      continue;
+    const float top = std::max(0.0f, ymin[c] - grow);
+    const float bottom = std::min(float(height), ymax[c] + grow);
+    if (top >= bottom)
+      continue;
+
+    const int r0 = int(top);
+    const int r1 = std::min(height - 1, int(ceilf(bottom)) - 1);
+    QRgb *p = bits + r0 * stride + c;
+    if (r0 == r1) {
+      blend(p, src, int(256 * (bottom - top)));
+      continue;
+    }
+    // partial pixels at both ends, full ones in between
+    blend(p, src, int(256 * (r0 + 1 - top)));
+    p += stride;
+    for(int r = r0 + 1; r < r1; ++r, p += stride)
+      blend(p, src, 256);
+    blend(p, src, int(256 * (bottom - r1)));
+  }
+  reset();
+}
+
+/**
+ * fill the area between the polylines @a lo and @a hi
+ */
+void Rasterizer::band(const float *x, const float *lo, const float *hi, 
+      int n, const QColor &color)
+{
+  extent(x, lo, n);
+  extent(x, hi, n);
+  fill(color, 0);
+}
+
+/**
+ * draw a polyline one pixel wide
+ */
+void Rasterizer::line(const float *x, const float *y, int n, 
+      const QColor &color)
+{
+  extent(x, y, n);
+  fill(color, 0.5f);
+}
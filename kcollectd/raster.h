@@ -0,0 +1,62 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <vector>
+
+#include <QColor>
+#include <QImage>
+
+/**
+ * antialiased rasterizer for the two primitives of a graph: the band
+ * between two polylines and a polyline
+ *
+ * both are reduced to one vertical span per pixel-column, with
+ * partial coverage at the ends of the span, and blended into an
+ * ARGB32_Premultiplied image. Coordinates are continuous pixels
+ * relative to the image, pixel (x, y) covers [x, x+1) × [y, y+1). x has
+ * to increase along the polylines. Everything outside the image is
+ * clipped.
+ */
+class Rasterizer
+{
+public:
+  explicit Rasterizer(QImage *image);
+
+  void band(const float *x, const float *lo, const float *hi, int n, 
+	const QColor &color);
+  void line(const float *x, const float *y, int n, const QColor &color);
+
+private:
+  void reset();
+  void extent(const float *x, const float *y, int n);
+  void fill(const QColor &color, float grow);
+
+  QImage *image;
+  int width, height;
+  // vertical extent per column and the columns touched
+  std::vector<float> ymin, ymax;
+  int first, last;
+};
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include "misc.h"
+#include "graph.h"
+#include "replay.h"
+
+/**
+ * opens @a filename for recording, an existing file is overwritten
+ */
+ViewRecorder::ViewRecorder(const QString &filename)
+  : file(filename), started(monotonic_seconds())
+{
+  if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    stream.setDevice(&file);
+  record("start", time(0));
+}
+
+/**
+ * append operation @a op with arguments @a arg and @a arg2 to the
+ * recording, a second argument of 0 is left out
+ */
+void ViewRecorder::record(const char *op, double arg, double arg2)
+{
+  if (!isOpen()) return;
+
+  const long ms = (monotonic_seconds() - started) * 1000.0;
+  stream << ms << ' ' << op << ' ' << qSetRealNumberPrecision(12) << arg;
+  if (arg2)
+    stream << ' ' << arg2;
+  stream << '\n';
+  stream.flush();
+}
+
+/**
+ * timings of all replayed steps of one kind of operation
+ */
+struct step_stats {
+  std::vector<double> frame_ms;
+  unsigned long fetches;
+  step_stats() : fetches(0) { }
+};
+
+/**
+ * nearest-rank percentile of sorted @a v
+ */
+static double percentile(const std::vector<double> &v, double p)
+{
+  if (v.empty()) return 0;
+  size_t rank = ceil(p * v.size());
+  if (rank < 1) rank = 1;
+  return v[rank-1];
+}
+
+/**
+ * apply the operation @a op to @a graph, returns false on unknown ops
+ */
+static bool apply(Graph *graph, const std::string &op, double arg, 
+      double arg2)
+{
+  if (op == "view")
+    graph->view(time_t(arg), time_t(arg2));
+  else if (op == "last")
+    graph->last(time_t(arg));
+  else if (op == "zoom")
+    graph->zoom(arg);
+  else if (op == "pan")
+    graph->pan(time_t(arg));
+  else if (op == "tick")
+    graph->tick();
+  else if (op == "auto")
+    graph->autoUpdate(arg != 0);
+  else if (op == "split")
+    graph->splitGraph();
+  else
+    return false;
+  return true;
+}
+
+/**
+ * replay the recorded view-operations in @a filename on @a graph
+ *
+ * The graph is rendered offscreen with @a size after every operation,
+ * at the time the operation was recorded at. Time-to-frame percentiles
+ * and rrd-fetches per step are written to @a os, grouped by
+ * operation. Returns an exit-status.
+ */
+int replay(Graph *graph, const QString &filename, const QSize &size, 
+      std::ostream &os)
+{
+  QFile in(filename);
+  if (!in.open(QIODevice::ReadOnly)) {
+    os << "can not open " << filename.toLocal8Bit().data() << std::endl;
+    return 1;
+  }
+
+  graph->resize(size);
+  graph->redraw();
+
+  std::map<std::string, step_stats> stats;
+  time_t started = 0;
+  QTextStream stream(&in);
+  while (!stream.atEnd()) {
+    QString line = stream.readLine();
+    QTextStream fields(&line, QIODevice::ReadOnly);
+    long ms = 0;
+    QString op;
+    double arg = 0, arg2 = 0;
+    fields >> ms >> op >> arg >> arg2;
+    if (op.isEmpty()) continue;
+
+    const std::string name(op.toAscii().data());
+    if (name == "start") {
+      started = time_t(arg);
+      continue;
+    }
+    if (started)
+      graph->clock(started + ms / 1000);
+    const unsigned long fetches = graph->fetches();
+    const double t0 = monotonic_seconds();
+    if (!apply(graph, name, arg, arg2)) {
+      os << "ignoring unknown operation " << name << std::endl;
+      continue;
+    }
+    graph->redraw();
+    const double t1 = monotonic_seconds();
+
+    step_stats &s = stats[name];
+    s.frame_ms.push_back((t1 - t0) * 1000.0);
+    s.fetches += graph->fetches() - fetches;
+  }
+  graph->autoUpdate(false);
+  graph->clock(0);
+
+  os << std::left << std::setw(8) << "op" << std::right 
+     << std::setw(8) << "steps" 
+     << std::setw(10) << "p50 ms" 
+     << std::setw(10) << "p95 ms" 
+     << std::setw(10) << "p99 ms"
+     << std::setw(12) << "fetch/step" << std::endl;
+  os << std::fixed << std::setprecision(2);
+  for(std::map<std::string, step_stats>::iterator i = stats.begin(); 
+      i != stats.end(); ++i) {
+    std::vector<double> &v = i->second.frame_ms;
+    std::sort(v.begin(), v.end());
+    os << std::left << std::setw(8) << i->first << std::right 
+       << std::setw(8) << v.size()
+       << std::setw(10) << percentile(v, 0.50)
+       << std::setw(10) << percentile(v, 0.95)
+       << std::setw(10) << percentile(v, 0.99)
+       << std::setw(12) << double(i->second.fetches) / v.size() 
+       << std::endl;
+  }
+  return 0;
+}
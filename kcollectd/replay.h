@@ -0,0 +1,59 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <iostream>
+
+#include <QFile>
+#include <QSize>
+#include <QString>
+#include <QTextStream>
+
+class Graph;
+
+/**
+ * records the view-operations done on a Graph into a file
+ *
+ * every line holds the time in ms since recording started, the name
+ * of the operation and its arguments. The first line holds the time
+ * recording started at, replay() takes the recorded times as the
+ * current time, so views relative to now are reproduced.
+ */
+class ViewRecorder
+{
+public:
+  explicit ViewRecorder(const QString &filename);
+
+  bool isOpen() const { return file.isOpen(); }
+  void record(const char *op, double arg = 0, double arg2 = 0);
+
+private:
+  QFile file;
+  QTextStream stream;
+  double started;
+};
+
+int replay(Graph *graph, const QString &filename, const QSize &size, 
+      std::ostream &os);
+
+#endif
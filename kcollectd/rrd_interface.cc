@@ -23,6 +23,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -32,8 +33,16 @@
 
 #include <rrd.h>
 #include <errno.h>
+#include <sys/stat.h>
+
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
 
 #include "rrd_interface.h"
+#include "trace.h"
 
 /**
  * wrapper for rrd_info taking a string instead of char*
@@ -79,6 +88,41 @@ void get_dsinfo(const std::string &rrdfile, std::set<std::string> &list)
     rrd_info_free(infos);  
 }
 
+/**
+ * position of datasource @a ds in the rrd, -1 if it does not exist
+ *
+ * using rrd_info
+ */
+int get_ds_index(const std::string &rrdfile, const std::string &ds)
+{
+  int index = -1;
+  const std::string key = "ds[" + ds + "].index";
+
+  rrd_info_t *infos = rrd_info(2, rrdfile);
+  for (rrd_info_t *i = infos; i; i = i->next) {
+    if (key == i->key && i->type == RD_I_CNT) {
+      index = i->value.u_cnt;
+      break;
+    }
+  }
+  if (infos) 
+    rrd_info_free(infos);  
+  return index;
+}
+
+/**
+ * time of the last write to @a rrdfile in seconds, 0 if unknown
+ *
+ * a stat is much cheaper than reading last_update from the header
+ */
+double get_rrd_mtime(const std::string &rrdfile)
+{
+  struct stat st;
+  if (stat(rrdfile.c_str(), &st) != 0)
+    return 0;
+  return st.st_mtim.tv_sec + st.st_mtim.tv_nsec * 1e-9;
+}
+
 /**
  * gets data from a rrd
  *
@@ -94,6 +138,7 @@ void get_rrd_data (const std::string &file, const std::string &ds,
   rrd_value_t *data;
   int status;
 
+  TraceSpan trace("fetch", "rrd", "file", file.c_str(), "cf", type);
   result->clear();
 
   status = rrd_fetch_r(file.c_str(), type, 
@@ -119,3 +164,71 @@ void get_rrd_data (const std::string &file, const std::string &ds,
   free(ds_name);
   free(data);
 }
+
+namespace {
+
+/**
+ * does requests of one call of get_rrd_data until none are left
+ */
+class FetchJob : public QRunnable {
+  std::vector<rrd_request> &requests;
+  QAtomicInt &next;
+  QSemaphore &done;
+public:
+  FetchJob(std::vector<rrd_request> &r, QAtomicInt &n, QSemaphore &d) 
+    : requests(r), next(n), done(d) { }
+  virtual void run() {
+    for(int i; (i = next.fetchAndAddRelaxed(1)) < int(requests.size()); ) {
+      rrd_request &r = requests[i];
+      get_rrd_data(r.file, r.ds, &r.start, &r.end, &r.step, r.type, r.result);
+    }
+    done.release();
+  }
+};
+
+/**
+ * the threads fetching for all calls of get_rrd_data
+ *
+ * they live as long as the program, so repeated fetches do not create
+ * new threads, each with its own trace-buffer.
+ */
+class FetchPool : public QThreadPool {
+public:
+  FetchPool() { setExpiryTimeout(-1); }
+};
+
+}
+
+static QThreadPool &fetch_pool()
+{
+  static FetchPool pool;
+  return pool;
+}
+
+/**
+ * does all @a requests with at most @a max_threads concurrent fetches
+ *
+ * rrd_fetch_r is reentrant, so the requests are handed to a shared
+ * threadpool. A @a max_threads of 0 uses one thread per core.
+ */
+void get_rrd_data (std::vector<rrd_request> &requests, int max_threads)
+{
+  if (requests.size() == 1) {
+    rrd_request &r = requests.front();
+    get_rrd_data(r.file, r.ds, &r.start, &r.end, &r.step, r.type, r.result);
+    return;
+  }
+  if (requests.empty())
+    return;
+
+  QThreadPool &pool = fetch_pool();
+  const int jobs = std::min(int(requests.size()), 
+	max_threads > 0 ? max_threads : QThread::idealThreadCount());
+  if (pool.maxThreadCount() < jobs)
+    pool.setMaxThreadCount(jobs);
+  QAtomicInt next(0);
+  QSemaphore done;
+  for(int k=0; k<jobs; ++k)
+    pool.start(new FetchJob(requests, next, done));
+  done.acquire(jobs);
+}
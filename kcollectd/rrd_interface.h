@@ -32,8 +32,26 @@
 
 void get_dsinfo(const std::string &rrdfile, std::set<std::string> &list);
 
+int get_ds_index(const std::string &rrdfile, const std::string &ds);
+
+double get_rrd_mtime(const std::string &rrdfile);
+
 void get_rrd_data (const std::string &file, const std::string &ds, 
       time_t *start, time_t *end, unsigned long *step, const char *type, 
       std::vector<double> *result);
 
+/**
+ * arguments and results of one get_rrd_data call
+ */
+struct rrd_request {
+  std::string file;
+  std::string ds;
+  const char *type;
+  time_t start, end;
+  unsigned long step;
+  std::vector<double> *result;
+};
+
+void get_rrd_data (std::vector<rrd_request> &requests, int max_threads);
+
 #endif
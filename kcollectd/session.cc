@@ -0,0 +1,400 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDomDocument>
+
+#include <KLocale>
+
+#include "aggregate.h"
+#include "catalog.h"
+#include "session.h"
+
+static const quint32 magic = 0x4b434453;	// "KCDS"
+static const quint32 version = 2;
+
+// offset, size, rows_start and rows_step of a series
+static const qint64 index_entry_size = 2*sizeof(qint64) + sizeof(qint32) 
+  + sizeof(quint64);
+
+static void write_series(QDataStream &stream, const std::vector<double> &v)
+{
+  stream << quint32(v.size());
+  for(std::vector<double>::const_iterator i = v.begin(); i != v.end(); ++i)
+    stream << *i;
+}
+
+static bool read_series(QDataStream &stream, std::vector<double> &v)
+{
+  quint32 n;
+  stream >> n;
+  if (stream.status() != QDataStream::Ok 
+	|| n > stream.device()->bytesAvailable() / sizeof(double))
+    return false;
+  v.resize(n);
+  for(quint32 i=0; i<n; ++i)
+    stream >> v[i];
+  return stream.status() == QDataStream::Ok;
+}
+
+SessionFile::SessionFile() : map(0), length(0), start_(0), span_(0), 
+			     data_start(0), data_end(0), step_(0)
+{
+}
+
+SessionFile::~SessionFile()
+{
+  if (map)
+    file.unmap(const_cast<uchar *>(map));
+}
+
+/**
+ * true if @a filename starts like a binary session-file
+ */
+bool SessionFile::isSessionFile(const QString &filename)
+{
+  QFile in(filename);
+  if (!in.open(QIODevice::ReadOnly))
+    return false;
+  QDataStream stream(&in);
+  quint32 m = 0;
+  stream >> m;
+  return m == magic;
+}
+
+/**
+ * write the layout of @a graph and the data it shows to @a filename
+ */
+bool SessionFile::write(const QString &filename, const Graph &graph, 
+      QString *error)
+{
+  // compress the series first, the index needs their sizes
+  std::vector<QByteArray> blobs;
+  std::vector<const GraphInfo::datasource *> stored;
+  if (graph.dataValid()) {
+    for(Graph::const_iterator i = graph.begin(); i != graph.end(); ++i)
+      for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j) {
+	if (!j->fetched) continue;
+	QByteArray raw;
+	QDataStream stream(&raw, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_4_4);
+	write_series(stream, j->avg_data);
+	write_series(stream, j->min_data);
+	write_series(stream, j->max_data);
+	blobs.push_back(qCompress(raw));
+	stored.push_back(&*j);
+      }
+  }
+
+  QFile out(filename);
+  if (!out.open(QIODevice::WriteOnly)) {
+    *error = out.errorString();
+    return false;
+  }
+  QDataStream stream(&out);
+  stream.setVersion(QDataStream::Qt_4_4);
+
+  // header
+  stream << magic << version << qint32(graph.updateInterval()) 
+	 << qint64(graph.viewStart()) << qint64(graph.range())
+	 << qint64(graph.dataStart()) << qint64(graph.dataEnd()) 
+	 << quint64(graph.dataStep());
+
+  // layout
+  qint32 snapshot = 0;
+  stream << quint32(graph.end() - graph.begin());
+  for(Graph::const_iterator i = graph.begin(); i != graph.end(); ++i) {
+    stream << quint32(i->wildcards().size());
+    for(std::vector<GraphInfo::wildcard>::const_iterator w 
+	  = i->wildcards().begin(); w != i->wildcards().end(); ++w)
+      stream << w->rrd << w->ds << w->label;
+
+    stream << quint32(i->size());
+    for(GraphInfo::const_iterator j = i->begin(); j != i->end(); ++j) {
+      const bool stored = !blobs.empty() && j->fetched;
+      stream << j->rrd << j->ds << j->label 
+	     << QString(aggregate_name(j->aggregate)) << j->quantile 
+	     << quint8(j->generated) << qint32(stored ? snapshot++ : -1)
+	     << quint32(j->members.size());
+      for(std::vector<rrd_source>::const_iterator m = j->members.begin();
+	  m != j->members.end(); ++m)
+	stream << QString::fromUtf8(m->file.c_str()) 
+	       << QString::fromUtf8(m->ds.c_str());
+    }
+  }
+
+  // index and data
+  stream << quint32(blobs.size());
+  qint64 offset = out.pos() + blobs.size() * index_entry_size;
+  for(size_t i=0; i<blobs.size(); ++i) {
+    // every series on the grid of its own rows
+    const bool own = stored[i]->rows_step != 0;
+    stream << offset << qint32(blobs[i].size()) 
+	   << qint64(own ? stored[i]->rows_start : graph.dataStart())
+	   << quint64(own ? stored[i]->rows_step : graph.dataStep());
+    offset += blobs[i].size();
+  }
+  for(size_t i=0; i<blobs.size(); ++i)
+    stream.writeRawData(blobs[i].constData(), blobs[i].size());
+
+  if (stream.status() != QDataStream::Ok || out.error() != QFile::NoError) {
+    *error = out.errorString();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * map @a filename and add the graphs in it to @a graph
+ *
+ * the series stay in the file until series() decodes them.
+ */
+bool SessionFile::read(const QString &filename, Graph *graph, 
+      QString *error)
+{
+  file.setFileName(filename);
+  if (!file.open(QIODevice::ReadOnly)) {
+    *error = file.errorString();
+    return false;
+  }
+  length = file.size();
+  map = file.map(0, length);
+  if (!map) {
+    *error = file.errorString();
+    return false;
+  }
+
+  const QByteArray bytes = 
+    QByteArray::fromRawData(reinterpret_cast<const char *>(map), length);
+  QDataStream stream(bytes);
+  stream.setVersion(QDataStream::Qt_4_4);
+
+  // header
+  quint32 m, v;
+  stream >> m >> v;
+  if (stream.status() != QDataStream::Ok || m != magic 
+	|| v < 1 || v > version) {
+    *error = i18n("not a session-file of this version of kcollectd");
+    return false;
+  }
+  qint32 interval;
+  qint64 start, span, first, last;
+  quint64 step;
+  stream >> interval >> start >> span >> first >> last >> step;
+  start_ = start;
+  span_ = span;
+  data_start = first;
+  data_end = last;
+  step_ = step;
+  graph->updateInterval(interval);
+
+  // layout
+  quint32 graphs;
+  stream >> graphs;
+  for(quint32 g=0; g<graphs && stream.status() == QDataStream::Ok; ++g) {
+    GraphInfo &graphinfo = graph->add();
+    quint32 n;
+    stream >> n;
+    for(quint32 k=0; k<n && stream.status() == QDataStream::Ok; ++k) {
+      QString rrd, ds, label;
+      stream >> rrd >> ds >> label;
+      graphinfo.addWildcard(rrd, ds, label);
+    }
+
+    stream >> n;
+    for(quint32 k=0; k<n && stream.status() == QDataStream::Ok; ++k) {
+      GraphInfo::datasource d;
+      QString aggregate;
+      quint8 generated;
+      qint32 snapshot;
+      quint32 members;
+      stream >> d.rrd >> d.ds >> d.label >> aggregate >> d.quantile 
+	     >> generated >> snapshot >> members;
+      d.aggregate = aggregate_by_name(aggregate.toUtf8().data());
+      d.quantile = valid_quantile(d.quantile);
+      d.generated = generated;
+      d.snapshot = snapshot;
+      for(quint32 i=0; i<members && stream.status() == QDataStream::Ok; ++i) {
+	QString rrd, ds;
+	stream >> rrd >> ds;
+	d.members.push_back(rrd_source(rrd.toUtf8().data(), 
+		  ds.toUtf8().data()));
+      }
+      graphinfo.add(d);
+    }
+  }
+
+  // index of the series
+  quint32 series;
+  stream >> series;
+  // version 1 had only the global rows of the header
+  const qint64 entry_size = v < 2 ? sizeof(qint64) + sizeof(qint32) 
+    : index_entry_size;
+  if (stream.status() == QDataStream::Ok
+	&& series <= stream.device()->bytesAvailable() / entry_size) {
+    index.resize(series);
+    for(quint32 i=0; i<series; ++i) {
+      stream >> index[i].offset >> index[i].size;
+      index[i].rows_start = data_start;
+      index[i].rows_step = step_;
+      if (v >= 2) {
+	qint64 rows_start;
+	quint64 rows_step;
+	stream >> rows_start >> rows_step;
+	index[i].rows_start = rows_start;
+	index[i].rows_step = rows_step;
+      }
+      if (index[i].offset < 0 || index[i].size < 0 
+	    || index[i].offset + index[i].size > length) {
+	stream.setStatus(QDataStream::ReadCorruptData);
+	break;
+      }
+    }
+  }
+  if (stream.status() != QDataStream::Ok) {
+    index.clear();
+    *error = i18n("the session-file is damaged");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * decode the series number @a n into @a ds
+ */
+bool SessionFile::series(int n, GraphInfo::datasource *ds) const
+{
+  if (n < 0 || size_t(n) >= index.size())
+    return false;
+
+  const QByteArray raw = qUncompress(map + index[n].offset, index[n].size);
+  QDataStream stream(raw);
+  stream.setVersion(QDataStream::Qt_4_4);
+  ds->rows_start = index[n].rows_start;
+  ds->rows_step = index[n].rows_step;
+  return read_series(stream, ds->avg_data)
+    && read_series(stream, ds->min_data)
+    && read_series(stream, ds->max_data);
+}
+
+/**
+ * the plots of the <tab> @a t, settings missing there are taken from
+ * @a root
+ */
+static void read_tab(const QDomElement &root, const QDomElement &t, 
+      Graph *graph)
+{
+  const QString interval = t.attribute("update-interval", 
+	root.attribute("update-interval"));
+  if (!interval.isEmpty())
+    graph->updateInterval(interval.toInt());
+  graph->timeShift(t.attribute("time-shift", 
+	    root.attribute("time-shift", "0")).toLongLong());
+
+  QDomElement g = t.firstChildElement("graph");
+  while(!g.isNull()) {
+    GraphInfo &graphinfo = graph->add();
+    QDomElement p = g.firstChildElement("plot");
+    while(!p.isNull()) {
+      if (p.hasAttribute("aggregate")) {
+	GraphInfo::datasource agg;
+	agg.label = p.attribute("label");
+	agg.aggregate = aggregate_by_name(
+	  p.attribute("aggregate").toUtf8().data());
+	agg.quantile = valid_quantile(
+	  p.attribute("quantile", "0.5").toDouble());
+	QDomElement m = p.firstChildElement("member");
+	while(!m.isNull()) {
+	  agg.members.push_back(rrd_source(m.attribute("rrd").toUtf8().data(),
+		    m.attribute("ds").toUtf8().data()));
+	  m = m.nextSiblingElement("member");
+	}
+	graphinfo.add(agg);
+      } else if (SensorCatalog::isPattern(p.attribute("rrd"))
+	    || SensorCatalog::isPattern(p.attribute("ds"))) {
+	graphinfo.addWildcard(p.attribute("rrd"), p.attribute("ds"), 
+	      p.attribute("label"));
+      } else {
+	graphinfo.add(p.attribute("rrd"), p.attribute("ds"), p.attribute("label"));
+      }
+      p = p.nextSiblingElement();
+    }
+    g = g.nextSiblingElement();
+  }
+}
+
+/**
+ * read the xml- or binary session-file @a filename into new graphs,
+ * one per tab, without a window
+ *
+ * wildcard-plots are not expanded. The graphs belong to the caller,
+ * on failure @a tabs stays empty and @a error tells why.
+ */
+bool read_session(const QString &filename, std::vector<session_tab> &tabs, 
+      QString *error)
+{
+  tabs.clear();
+
+  // binary session-files, possibly with a snapshot of the data
+  if (SessionFile::isSessionFile(filename)) {
+    SessionFile *session = new SessionFile;
+    session_tab tab;
+    tab.graph = new Graph;
+    if (!session->read(filename, tab.graph, error)) {
+      delete session;
+      delete tab.graph;
+      return false;
+    }
+    if (session->hasData())
+      tab.graph->snapshot(session);
+    else
+      delete session;
+    tabs.push_back(tab);
+    return true;
+  }
+
+  QFile in(filename);
+  if (!in.open(QIODevice::ReadOnly)) {
+    *error = in.errorString();
+    return false;
+  }
+  QDomDocument doc;
+  doc.setContent(&in);
+  const QDomElement root = doc.documentElement();
+    
+  // every tab gets its own graph, settings of the root are defaults
+  QDomElement t = root.firstChildElement("tab");
+  if (t.isNull()) {
+    session_tab tab;
+    tab.graph = new Graph;
+    tabs.push_back(tab);
+  }
+  while(!t.isNull()) {
+    session_tab tab;
+    tab.label = t.attribute("label");
+    tab.graph = new Graph;
+    read_tab(root, t, tab.graph);
+    tabs.push_back(tab);
+    t = t.nextSiblingElement("tab");
+  }
+  return true;
+}
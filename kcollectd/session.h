@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <time.h>
+
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+#include "graph.h"
+
+/**
+ * binary session-file with an optional snapshot of the fetched data
+ *
+ * The file holds a header with the view, the layout of all graphs
+ * and, if there was valid data, an index of the series and the grid of
+ * their rows followed by the qCompress'd series themselves. Reading
+ * maps the file and decodes only header and layout, a series is
+ * decoded when series() is asked for it.
+ */
+class SessionFile
+{
+public:
+  SessionFile();
+  ~SessionFile();
+
+  static bool isSessionFile(const QString &file);
+  static bool write(const QString &file, const Graph &graph, 
+	QString *error);
+
+  bool read(const QString &file, Graph *graph, QString *error);
+  bool series(int index, GraphInfo::datasource *ds) const;
+
+  bool hasData() const { return !index.empty(); }
+  time_t start() const { return start_; }
+  time_t span() const { return span_; }
+  time_t dataStart() const { return data_start; }
+  time_t dataEnd() const { return data_end; }
+  unsigned long step() const { return step_; }
+
+private:
+  struct entry {
+    qint64 offset;
+    qint32 size;
+    time_t rows_start;
+    unsigned long rows_step;
+  };
+
+  QFile file;
+  const uchar *map;
+  qint64 length;
+  std::vector<entry> index;
+  time_t start_, span_, data_start, data_end;
+  unsigned long step_;
+};
+
+/** a tab of a kcollectd-file */
+struct session_tab {
+  QString label;
+  Graph *graph;
+};
+
+bool read_session(const QString &file, std::vector<session_tab> &tabs, 
+      QString *error);
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "aggregate.h"
+#include "stats.h"
+
+namespace {
+
+const time_t block_rows = 256;
+const size_t exact_limit = 4096; // smaller windows get exact quantiles
+
+const double accuracy = 0.01;
+const double bucket_gamma = (1 + accuracy) / (1 - accuracy);
+const double log_gamma = log(bucket_gamma);
+const int key_offset = 1 << 17;	// keeps keys of all finite doubles > 0
+
+const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+/**
+ * bucket of @a v, ordered like the values
+ */
+inline int bucket_key(double v)
+{
+  if (v == 0) 
+    return 0;
+  const double l = std::min(std::max(ceil(log(fabs(v)) / log_gamma), 
+	    1.0 - key_offset), key_offset - 1.0);
+  const int i = (int)l + key_offset;
+  return v > 0 ? i : -i;
+}
+
+/**
+ * value representing all values of bucket @a key
+ */
+inline double bucket_value(int key)
+{
+  if (key == 0) 
+    return 0;
+  const double v = 2 * pow(bucket_gamma, abs(key) - key_offset) 
+    / (bucket_gamma + 1);
+  return key > 0 ? v : -v;
+}
+
+inline time_t floor_div(time_t a, time_t b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+} // namespace
+
+/**
+ * sketch of the @a n values @a v, replacing the former content
+ */
+void quantile_sketch::build(const double *v, size_t n)
+{
+  std::vector<int> keys(n);
+  for(size_t i=0; i<n; ++i)
+    keys[i] = bucket_key(v[i]);
+  std::sort(keys.begin(), keys.end());
+
+  buckets.clear();
+  for(size_t i=0; i<n;) {
+    size_t j = i + 1;
+    while(j < n && keys[j] == keys[i]) ++j;
+    buckets.push_back(std::make_pair(keys[i], (unsigned long)(j - i)));
+    i = j;
+  }
+  count_ = n;
+}
+
+void quantile_sketch::merge(const quantile_sketch &other)
+{
+  if (other.buckets.empty())
+    return;
+  if (buckets.empty()) {
+    *this = other;
+    return;
+  }
+
+  std::vector<std::pair<int, unsigned long> > merged;
+  merged.reserve(buckets.size() + other.buckets.size());
+  size_t i = 0, j = 0;
+  while(i < buckets.size() && j < other.buckets.size()) {
+    if (buckets[i].first < other.buckets[j].first) {
+      merged.push_back(buckets[i++]);
+    } else if (other.buckets[j].first < buckets[i].first) {
+      merged.push_back(other.buckets[j++]);
+    } else {
+      merged.push_back(std::make_pair(buckets[i].first, 
+		  buckets[i].second + other.buckets[j].second));
+      ++i, ++j;
+    }
+  }
+  merged.insert(merged.end(), buckets.begin() + i, buckets.end());
+  merged.insert(merged.end(), other.buckets.begin() + j, other.buckets.end());
+  buckets.swap(merged);
+  count_ += other.count_;
+}
+
+/**
+ * quantile @a q of the values, NaN if empty
+ */
+double quantile_sketch::quantile(double q) const
+{
+  if (!count_)
+    return NaN;
+
+  const double rank = q * (count_ - 1);
+  unsigned long seen = 0;
+  for(size_t i=0; i<buckets.size(); ++i) {
+    seen += buckets[i].second;
+    if (seen > rank) 
+      return bucket_value(buckets[i].first);
+  }
+  return bucket_value(buckets.back().first);
+}
+
+/**
+ * memory held by the buckets
+ */
+size_t quantile_sketch::bytes() const
+{
+  return buckets.capacity() * sizeof(buckets[0]);
+}
+
+/**
+ * memory held by the blocks and their sketches
+ */
+size_t series_stats::bytes() const
+{
+  size_t b = blocks.capacity() * sizeof(block);
+  for(std::vector<block>::const_iterator i = blocks.begin(); 
+      i != blocks.end(); ++i)
+    b += i->sketch.bytes();
+  return b;
+}
+
+/**
+ * summary of the rows [@a from, @a to) into @a b
+ */
+void series_stats::scan(const std::vector<double> &data, 
+      const std::vector<double> &mins, const std::vector<double> &maxs, 
+      size_t from, size_t to, block &b)
+{
+  const bool has_min = mins.size() == data.size();
+  const bool has_max = maxs.size() == data.size();
+
+  std::vector<double> valid;
+  valid.reserve(to - from);
+  b.count = 0;
+  b.sum = 0;
+  b.min = std::numeric_limits<double>::infinity();
+  b.max = -std::numeric_limits<double>::infinity();
+  for(size_t i=from; i<to; ++i) {
+    const double v = data[i];
+    if (v != v) continue;
+    valid.push_back(v);
+    b.sum += v;
+    const double lo = has_min && mins[i] == mins[i] ? mins[i] : v;
+    const double hi = has_max && maxs[i] == maxs[i] ? maxs[i] : v;
+    if (lo < b.min) b.min = lo;
+    if (hi > b.max) b.max = hi;
+  }
+  b.count = valid.size();
+  b.sketch.build(valid.empty() ? 0 : &valid[0], valid.size());
+}
+
+/**
+ * recalculate the stats of a series starting at @a start
+ *
+ * @a data, @a mins and @a maxs are the series as fetched, min and max may be
+ * empty. Rows up to the last known value of the previous update are
+ * taken to be final and their blocks are reused.
+ */
+void series_stats::update(const std::vector<double> &data, 
+      const std::vector<double> &mins, const std::vector<double> &maxs, 
+      time_t start, unsigned long step)
+{
+  const time_t row0 = start / (time_t)step;
+  const time_t n = data.size();
+
+  time_t last_valid = n;
+  for(time_t i = n-1; i >= 0; --i)
+    if (data[i] == data[i]) {
+      last_valid = i;
+      break;
+    }
+
+  std::vector<block> next;
+  const time_t next_first = floor_div(row0, block_rows);
+  if (n) {
+    next.resize(floor_div(row0 + n - 1, block_rows) - next_first + 1);
+    for(size_t k=0; k<next.size(); ++k) {
+      const time_t lo = (next_first + k) * block_rows;
+      const time_t hi = lo + block_rows;
+      const bool complete = lo >= row0 && hi <= row0 + n;
+      const time_t old = next_first + k - first_block;
+      if (complete && step == step_ && old >= 0 && old < (time_t)blocks.size()
+	    && blocks[old].complete && hi <= final_end) {
+	next[k] = blocks[old];
+      } else {
+	scan(data, mins, maxs, std::max(lo, row0) - row0, 
+	      std::min(hi, row0 + n) - row0, next[k]);
+	next[k].complete = complete;
+      }
+    }
+  }
+  blocks.swap(next);
+  first_block = next_first;
+  step_ = step;
+  final_end = row0 + (last_valid < n ? last_valid : 0);
+
+  // merge the blocks
+  count = 0;
+  double sum = 0;
+  min = std::numeric_limits<double>::infinity();
+  max = -std::numeric_limits<double>::infinity();
+  for(std::vector<block>::const_iterator b = blocks.begin(); 
+      b != blocks.end(); ++b) {
+    if (!b->count) continue;
+    count += b->count;
+    sum += b->sum;
+    min = std::min(min, b->min);
+    max = std::max(max, b->max);
+  }
+  if (!count) {
+    min = avg = max = p95 = last = NaN;
+    return;
+  }
+  avg = sum / count;
+  last = data[last_valid];
+
+  if (count <= exact_limit) {
+    std::vector<double> valid;
+    valid.reserve(count);
+    for(time_t i=0; i<n; ++i)
+      if (data[i] == data[i]) valid.push_back(data[i]);
+    p95 = select_quantile(&valid[0], valid.size(), 0.95);
+  } else {
+    quantile_sketch sketch;
+    for(std::vector<block>::const_iterator b = blocks.begin(); 
+	b != blocks.end(); ++b)
+      sketch.merge(b->sketch);
+    p95 = std::min(std::max(sketch.quantile(0.95), min), max);
+  }
+}
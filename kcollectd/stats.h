@@ -0,0 +1,90 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <time.h>
+
+#include <utility>
+#include <vector>
+
+/**
+ * mergeable quantile-sketch with 1% relative accuracy
+ *
+ * Values are counted in logarithmic buckets like DDSketch does, so
+ * sketches of adjacent pieces of a series merge by adding counts.
+ */
+class quantile_sketch {
+ public:
+  quantile_sketch() : count_(0) { }
+  void build(const double *v, size_t n);
+  void merge(const quantile_sketch &other);
+  double quantile(double q) const;
+  unsigned long count() const { return count_; }
+  size_t bytes() const;
+
+ private:
+  std::vector<std::pair<int, unsigned long> > buckets; // sorted by key
+  unsigned long count_;
+};
+
+/**
+ * min/avg/max/p95/last of a series
+ *
+ * The series is split into blocks of rows aligned to the rrd-grid,
+ * each with its own summary. After a refetch of a moved window only
+ * blocks not seen completely before are scanned again; the window is
+ * the merge of its blocks.
+ */
+class series_stats {
+ public:
+  series_stats() : count(0), generation(0), step_(0), first_block(0), 
+		   final_end(0) { }
+
+  void update(const std::vector<double> &data, 
+	const std::vector<double> &mins, const std::vector<double> &maxs, 
+	time_t start, unsigned long step);
+  size_t bytes() const;
+
+  double min, avg, max, p95, last;
+  unsigned long count;		// valid values, the rest is undefined if 0
+  unsigned long generation;	// of the data the stats are from
+
+ private:
+  struct block {
+    unsigned long count;
+    double sum, min, max;
+    quantile_sketch sketch;
+    bool complete;		// all rows of the block were in the series
+  };
+
+  void scan(const std::vector<double> &data, 
+	const std::vector<double> &mins, const std::vector<double> &maxs, 
+	size_t from, size_t to, block &b);
+
+  std::vector<block> blocks;
+  unsigned long step_;
+  time_t first_block;		// absolute index of blocks[0]
+  time_t final_end;		// rows before this won't change anymore
+};
+
+#endif
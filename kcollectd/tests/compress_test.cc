@@ -0,0 +1,150 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ * 
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * checks that packed_series decodes bit-exact to what was packed,
+ * whole and in ranges
+ */
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "../compress.h"
+
+static int failures = 0;
+
+static uint64_t bits(double d)
+{
+  uint64_t b;
+  memcpy(&b, &d, sizeof(b));
+  return b;
+}
+
+static double from_bits(uint64_t b)
+{
+  double d;
+  memcpy(&d, &b, sizeof(d));
+  return d;
+}
+
+/** true if @a a and @a b hold the same bits */
+static bool same(const double *a, const double *b, size_t n)
+{
+  for(size_t i=0; i<n; ++i)
+    if (bits(a[i]) != bits(b[i]))
+      return false;
+  return true;
+}
+
+static void check(const char *name, const std::vector<double> &data)
+{
+  packed_series p;
+  p.pack(data);
+  if (p.size() != data.size()) {
+    ++failures;
+    fprintf(stderr, "%s: size %lu, want %lu\n", name, 
+	  (unsigned long)p.size(), (unsigned long)data.size());
+    return;
+  }
+
+  std::vector<double> out;
+  p.unpack(out);
+  if (out.size() != data.size() 
+	|| (!data.empty() && !same(&out[0], &data[0], data.size()))) {
+    ++failures;
+    fprintf(stderr, "%s: whole series differs\n", name);
+  }
+
+  // ranges within, across and at the edges of blocks
+  const size_t n = data.size();
+  const size_t b = packed_series::block_rows;
+  const size_t edges[] = { 0, 1, b-1, b, b+1, 2*b, n/2, n-1, n };
+  const size_t count = sizeof(edges)/sizeof(*edges);
+  for(size_t i=0; i<count; ++i)
+    for(size_t j=0; j<count; ++j) {
+      const size_t first = edges[i], last = edges[j];
+      if (first >= last || last > n) continue;
+      std::vector<double> range(last - first);
+      p.unpack(first, last, &range[0]);
+      if (!same(&range[0], &data[first], last - first)) {
+	++failures;
+	fprintf(stderr, "%s: rows %lu to %lu differ\n", name, 
+	      (unsigned long)first, (unsigned long)last);
+      }
+    }
+
+  p.clear();
+  if (!p.empty() || p.size() != 0) {
+    ++failures;
+    fprintf(stderr, "%s: not empty after clear\n", name);
+  }
+}
+
+int main()
+{
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double inf = std::numeric_limits<double>::infinity();
+  const size_t b = packed_series::block_rows;
+
+  check("empty", std::vector<double>());
+  check("one value", std::vector<double>(1, 42.5));
+  check("one NaN", std::vector<double>(1, nan));
+  check("constant", std::vector<double>(3*b + 17, 0.1));
+
+  // runs of NaN, also over block boundaries
+  std::vector<double> gaps(5*b);
+  for(size_t i=0; i<gaps.size(); ++i)
+    gaps[i] = (i / 100) % 2 ? nan : 1.0 + i * 0.25;
+  check("NaN runs", gaps);
+
+  // special values next to ordinary ones
+  const double special[] = { 0.0, -0.0, inf, -inf, nan, -nan, 
+			     std::numeric_limits<double>::denorm_min(),
+			     std::numeric_limits<double>::max(),
+			     -std::numeric_limits<double>::min(), 1.0 };
+  const size_t n_special = sizeof(special)/sizeof(*special);
+  std::vector<double> mixed;
+  for(size_t i=0; i<2*b + 3; ++i)
+    mixed.push_back(special[(i * 7) % n_special]);
+  check("special values", mixed);
+  check("negative zero", std::vector<double>(b + 1, -0.0));
+
+  // random bits, any pattern including NaN-payloads, and noisy
+  // measurements sharing their upper bits
+  srand(1);
+  std::vector<double> noise(4*b + 5), random(4*b + 5);
+  for(size_t i=0; i<random.size(); ++i) {
+    uint64_t r = 0;
+    for(int k=0; k<4; ++k)
+      r = (r << 16) ^ uint64_t(rand() & 0xffff);
+    random[i] = from_bits(r);
+    noise[i] = 1000.0 + (rand() % 1000) / 7.0;
+  }
+  check("random bits", random);
+  check("noise", noise);
+
+  if (failures)
+    fprintf(stderr, "%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ * 
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * checks parse_collectd_packet and collectd_rate on hand-built packets
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../netproto.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok) {
+    ++failures;
+    fprintf(stderr, "failed: %s\n", what);
+  }
+}
+
+static void put_u16(std::string &s, unsigned int v)
+{
+  s += char(v >> 8);
+  s += char(v);
+}
+
+static void put_u64(std::string &s, unsigned long long v)
+{
+  for(int i=7; i>=0; --i)
+    s += char(v >> (8*i));
+}
+
+/** a part of type @a type around @a body */
+static std::string part(unsigned int type, const std::string &body)
+{
+  std::string s;
+  put_u16(s, type);
+  put_u16(s, body.size() + 4);
+  return s + body;
+}
+
+/** a string-part, terminated like collectd sends it */
+static std::string string_part(unsigned int type, const char *value)
+{
+  return part(type, std::string(value, strlen(value) + 1));
+}
+
+static std::string number_part(unsigned int type, unsigned long long value)
+{
+  std::string body;
+  put_u64(body, value);
+  return part(type, body);
+}
+
+/** a values-part, gauges are little-endian, the rest big-endian */
+static std::string values_part(const std::vector<int> &types, 
+      const std::vector<double> &values)
+{
+  std::string body;
+  put_u16(body, types.size());
+  for(size_t i=0; i<types.size(); ++i)
+    body += char(types[i]);
+  for(size_t i=0; i<values.size(); ++i) {
+    if (types[i] == collectd_values::gauge) {
+      unsigned long long v;
+      memcpy(&v, &values[i], sizeof(v));
+      for(int k=0; k<8; ++k)
+	body += char(v >> (8*k));
+    } else {
+      put_u64(body, (unsigned long long)(long long)values[i]);
+    }
+  }
+  return part(0x0006, body);
+}
+
+static std::string header(const char *type_instance, double time)
+{
+  return string_part(0x0000, "host") 
+    + number_part(0x0008, (unsigned long long)(time * 1073741824.0))
+    + number_part(0x0009, 10ULL << 30)
+    + string_part(0x0002, "cpu") + string_part(0x0003, "0")
+    + string_part(0x0004, "cpu") + string_part(0x0005, type_instance);
+}
+
+static void collect(const collectd_values &vl, void *data)
+{
+  static_cast<std::vector<collectd_values> *>(data)->push_back(vl);
+}
+
+static bool parse(const std::string &packet, 
+      std::vector<collectd_values> &lists)
+{
+  lists.clear();
+  return parse_collectd_packet(packet.data(), packet.size(), collect, &lists);
+}
+
+static std::vector<int> types(int a, int b = -1)
+{
+  std::vector<int> t(1, a);
+  if (b >= 0) t.push_back(b);
+  return t;
+}
+
+static std::vector<double> values(double a, double b = NAN)
+{
+  std::vector<double> v(1, a);
+  if (!std::isnan(b)) v.push_back(b);
+  return v;
+}
+
+static void check_parts()
+{
+  std::vector<collectd_values> lists;
+
+  // two value-lists, the second only changes the type-instance
+  const std::string good = header("user", 1000.5) 
+    + values_part(types(collectd_values::gauge, collectd_values::derive),
+	  values(0.25, -7))
+    + string_part(0x0005, "idle") 
+    + values_part(types(collectd_values::counter), values(42));
+  check(parse(good, lists), "valid packet");
+  check(lists.size() == 2, "two value-lists");
+  if (lists.size() == 2) {
+    check(lists[0].identifier() == "host/cpu-0/cpu-user", "identifier");
+    check(lists[1].identifier() == "host/cpu-0/cpu-idle", "second identifier");
+    check(lists[0].time == 1000.5, "high-resolution time");
+    check(lists[0].interval == 10, "high-resolution interval");
+    check(lists[0].values.size() == 2 && lists[0].values[0] == 0.25
+	  && lists[0].values[1] == -7, "gauge and negative derive");
+    check(lists[1].types.size() == 1 
+	  && lists[1].types[0] == collectd_values::counter
+	  && lists[1].values[0] == 42, "counter");
+  }
+
+  // plain seconds, signatures are skipped
+  const std::string plain = string_part(0x0000, "h") 
+    + number_part(0x0001, 1234) + number_part(0x0007, 60)
+    + part(0x0200, std::string(32, 'x'))
+    + string_part(0x0002, "load") + string_part(0x0004, "load")
+    + values_part(types(collectd_values::gauge), values(1));
+  check(parse(plain, lists) && lists.size() == 1 
+	&& lists[0].time == 1234 && lists[0].interval == 60
+	&& lists[0].identifier() == "h/load/load", "plain time and interval");
+
+  // truncated behind the header of the last part: value-lists before
+  // the error are reported
+  for(size_t cut = 1; cut < 12; ++cut) {
+    const std::string t = good.substr(0, good.size() - cut);
+    check(!parse(t, lists) && lists.size() == 1, "truncated last part");
+  }
+  check(parse(good.substr(0, 2), lists) && lists.empty(), 
+	"less than a part-header");
+
+  // part-length shorter than its header
+  std::string bad = header("user", 1);
+  put_u16(bad, 0x0006);
+  put_u16(bad, 2);
+  check(!parse(bad, lists), "part shorter than 4 bytes");
+
+  // number of values does not match the length
+  std::string body;
+  put_u16(body, 2);
+  body += char(collectd_values::gauge);
+  body += std::string(8, 0);
+  check(!parse(header("user", 1) + part(0x0006, body), lists) 
+	&& lists.empty(), "values-length");
+  check(!parse(header("user", 1) + part(0x0006, std::string(1, 0)), lists),
+	"values without count");
+
+  // unknown type of a value
+  body.clear();
+  put_u16(body, 1);
+  body += char(7);
+  body += std::string(8, 0);
+  check(!parse(header("user", 1) + part(0x0006, body), lists), 
+	"unknown value-type");
+
+  // strings
+  check(!parse(part(0x0000, "host"), lists), "unterminated string");
+  check(!parse(part(0x0002, ""), lists), "empty string-part");
+
+  // times must have 8 bytes
+  check(!parse(part(0x0001, std::string(4, 0)), lists), "short time");
+
+  // encrypted packets are ignored
+  check(parse(part(0x0210, std::string(40, 'x')) + good, lists) 
+	&& lists.empty(), "encrypted packet");
+}
+
+/** one value-list of type @a type with @a raw at @a time */
+static collectd_values sample(int type, double raw, double time)
+{
+  std::vector<collectd_values> lists;
+  parse(header("x", time) + values_part(types(type), values(raw)), lists);
+  return lists.size() == 1 ? lists[0] : collectd_values();
+}
+
+static void check_rates()
+{
+  // counters: rates from the second value on, wraps give no value
+  collectd_rate counter;
+  check(std::isnan(counter.value(sample(collectd_values::counter, 100, 10), 0)),
+	"first counter");
+  check(counter.value(sample(collectd_values::counter, 160, 20), 0) == 6,
+	"counter rate");
+  check(std::isnan(counter.value(sample(collectd_values::counter, 50, 30), 0)),
+	"counter wrap");
+  check(counter.value(sample(collectd_values::counter, 80, 40), 0) == 3,
+	"counter after wrap");
+  check(std::isnan(counter.value(sample(collectd_values::counter, 90, 40), 0)),
+	"counter without time passed");
+
+  // derives may fall
+  collectd_rate derive;
+  check(std::isnan(derive.value(sample(collectd_values::derive, -10, 10), 0)),
+	"first derive");
+  check(derive.value(sample(collectd_values::derive, -60, 20), 0) == -5,
+	"falling derive");
+  check(derive.value(sample(collectd_values::derive, 40, 30), 0) == 10,
+	"rising derive");
+
+  // gauges as they are, absolutes per interval
+  collectd_rate gauge;
+  check(gauge.value(sample(collectd_values::gauge, 2.5, 10), 0) == 2.5, 
+	"gauge");
+  collectd_rate absolute;
+  check(absolute.value(sample(collectd_values::absolute, 50, 10), 0) == 5,
+	"absolute");
+}
+
+int main()
+{
+  check_parts();
+  check_rates();
+  if (failures)
+    fprintf(stderr, "%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ * 
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * checks time_iterator and tz_table against localtime_r and mktime
+ * for zones with odd transitions over 1990 to 2030
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "../timeaxis.h"
+
+static const char *zones[] = {
+  "Europe/Berlin", "America/New_York", "Australia/Lord_Howe", 
+  "America/Sao_Paulo", "Asia/Kolkata", "UTC", "Pacific/Chatham", 
+  "America/Santiago", "Asia/Tehran"
+};
+
+static const time_t first = 631152000;	// 1990-01-01
+static const time_t last = 1893456000;	// 2030-01-01
+
+static int failures = 0;
+
+static void fail(const char *zone, const char *what, time_t got, time_t want)
+{
+  if (++failures <= 20)
+    fprintf(stderr, "%s: %s: got %ld, want %ld\n", 
+	  zone, what, long(got), long(want));
+}
+
+/** local midnight of a date as mktime gives it */
+static time_t midnight(int y, int m, int d)
+{
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = y - 1900;
+  tm.tm_mon = m - 1;
+  tm.tm_mday = d;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+/**
+ * first minute from @a t on that is a multiple of @a step seconds
+ * after local midnight
+ */
+static time_t next_aligned(time_t t, time_t step)
+{
+  for(;;) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    const time_t s = (tm.tm_hour*3600 + tm.tm_min*60 + tm.tm_sec) % step;
+    if (s == 0)
+      return t;
+    // transitions move local time by at most an hour, back to the
+    // last boundary too
+    t += s < 3600 ? 60 : std::max(time_t(60), step - s - 3600);
+  }
+}
+
+/**
+ * offsets of tz_table against localtime_r every hour, and local
+ * midnights back to UTC against mktime
+ */
+static void check_table(const char *zone)
+{
+  tz_table table;
+  table.cover(first, last);
+  for(time_t t = first; t < last; t += 3600 + 17) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    if (table.local(t) != t + tm.tm_gmtoff)
+      fail(zone, "local", table.local(t), t + tm.tm_gmtoff);
+  }
+  for(time_t t = first; t < last; t += 3*24*3600) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    const time_t want = midnight(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    struct tm local = tm;
+    local.tm_hour = local.tm_min = local.tm_sec = 0;
+    const time_t got = table.utc(timegm(&local));
+    if (got != want)
+      fail(zone, "utc of midnight", got, want);
+  }
+}
+
+/**
+ * ticks of all iterator types from @a start, forwards and back
+ */
+static void check_iterators(const char *zone, time_t start)
+{
+  // second-based ticks on local boundaries
+  static const time_t steps[] = { 600, 3600, 3*3600, 24*3600 };
+  for(size_t k = 0; k < sizeof(steps)/sizeof(*steps); ++k) {
+    time_iterator it(start, steps[k]);
+    time_t want = start / 60 * 60;
+    for(int c = 0; c < 30; ++c, ++it) {
+      want = next_aligned(want + 60, steps[k]);
+      if (*it != want) {
+	fail(zone, "seconds", *it, want);
+	break;
+      }
+    }
+    for(int c = 0; c < 30; ++c)
+      --it;
+    time_iterator back(start, steps[k]);
+    if (*it != *back)
+      fail(zone, "seconds backwards", *it, *back);
+  }
+
+  struct tm tm;
+  localtime_r(&start, &tm);
+  int y = tm.tm_year + 1900, m = tm.tm_mon + 1;
+
+  time_iterator months(start, 1, time_iterator::month);
+  for(int c = 0; c < 30; ++c, ++months) {
+    if (++m > 12) {
+      m = 1;
+      ++y;
+    }
+    if (*months != midnight(y, m, 1))
+      fail(zone, "month", *months, midnight(y, m, 1));
+  }
+  --months;
+  if (*months != midnight(y, m, 1))
+    fail(zone, "month backwards", *months, midnight(y, m, 1));
+
+  time_iterator years(start, 2, time_iterator::years);
+  y = tm.tm_year + 1900 + 1;
+  for(int c = 0; c < 10; ++c, ++years, y += 2)
+    if (*years != midnight(y, 1, 1))
+      fail(zone, "year", *years, midnight(y, 1, 1));
+
+  // weeks start on monday
+  time_iterator weeks(start, 1, time_iterator::weeks);
+  int d = tm.tm_mday + (tm.tm_wday == 0 ? 1 : 8 - tm.tm_wday);
+  for(int c = 0; c < 20; ++c, ++weeks, d += 7) {
+    const time_t want = midnight(tm.tm_year + 1900, tm.tm_mon + 1, d);
+    if (*weeks != want)
+      fail(zone, "week", *weeks, want);
+  }
+
+  // broken-down time of the ticks
+  time_iterator hours(start, 3600);
+  for(int c = 0; c < 50; ++c, ++hours) {
+    const time_t t = *hours;
+    struct tm a;
+    localtime_r(&t, &a);
+    const struct tm *b = hours.tm();
+    if (a.tm_hour != b->tm_hour || a.tm_mday != b->tm_mday 
+	|| a.tm_isdst != b->tm_isdst || a.tm_gmtoff != b->tm_gmtoff 
+	|| strcmp(a.tm_zone, b->tm_zone))
+      fail(zone, "tm", t, t);
+  }
+}
+
+int main()
+{
+  for(size_t z = 0; z < sizeof(zones)/sizeof(*zones); ++z) {
+    setenv("TZ", zones[z], 1);
+    tzset();
+    check_table(zones[z]);
+    for(time_t start = first; start < last; start += 61*24*3600 + 12345)
+      check_iterators(zones[z], start);
+  }
+  if (failures)
+    fprintf(stderr, "%d failures\n", failures);
+  return failures != 0;
+}
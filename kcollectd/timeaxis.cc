@@ -18,8 +18,230 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+
 #include "timeaxis.h"
 
+namespace {
+
+const time_t day = 3600*24;
+const time_t week = 7*day;
+const time_t year = 366*day;
+
+inline time_t floor_div(time_t a, time_t b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/** days since 1970-01-01 of a date in the proleptic gregorian calendar */
+time_t days_from_civil(time_t y, int m, int d)
+{
+  y -= m <= 2;
+  const time_t era = floor_div(y, 400);
+  const time_t yoe = y - era * 400;
+  const time_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const time_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/** date of a day since 1970-01-01, inverse of days_from_civil */
+void civil_from_days(time_t z, time_t &y, int &m, int &d)
+{
+  z += 719468;
+  const time_t era = floor_div(z, 146097);
+  const time_t doe = z - era * 146097;
+  const time_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+  const time_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const time_t mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = yoe + era * 400 + (m <= 2);
+}
+
+inline bool same_offset(const tz_span &a, const struct tm &b)
+{
+  return a.gmtoff == b.tm_gmtoff && a.isdst == b.tm_isdst;
+}
+
+inline tz_span make_span(time_t t, const struct tm &tm)
+{
+  const tz_span s = { t, tm.tm_gmtoff, tm.tm_isdst, tm.tm_zone };
+  return s;
+}
+
+/**
+ * append the spans of [from, to) to @a spans
+ *
+ * localtime is sampled weekly and transitions are searched by
+ * bisection.
+ */
+void probe(time_t from, time_t to, std::vector<tz_span> &spans)
+{
+  struct tm tm;
+  localtime_r(&from, &tm);
+  spans.push_back(make_span(from, tm));
+
+  time_t t = from;
+  while (t < to - 1) {
+    const time_t next = to - 1 - t > week ? t + week : to - 1;
+    localtime_r(&next, &tm);
+    if (same_offset(spans.back(), tm)) {
+      t = next;
+      continue;
+    }
+    time_t lo = t, hi = next;
+    while (hi - lo > 1) {
+      const time_t mid = lo + (hi - lo) / 2;
+      localtime_r(&mid, &tm);
+      if (same_offset(spans.back(), tm))
+	lo = mid;
+      else
+	hi = mid;
+    }
+    localtime_r(&hi, &tm);
+    spans.push_back(make_span(hi, tm));
+    t = hi;
+  }
+}
+
+bool begins_after(time_t t, const tz_span &s)
+{
+  return t < s.begin;
+}
+
+/**
+ * the transitions of the local timezone seen so far
+ *
+ * dropped when the timezone changes.
+ */
+tz_table &local_zone()
+{
+  static tz_table table;
+  static std::string current;
+
+  tzset();
+  const char *tz = getenv("TZ");
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%ld", (long)timezone);
+  const std::string key = std::string(tz ? tz : "") + '\n' 
+    + tzname[0] + '\n' + tzname[1] + '\n' + buffer;
+  if (key != current) {
+    table.clear();
+    current = key;
+  }
+  return table;
+}
+
+} // namespace
+
+/**
+ * make sure [from, to) is in the table
+ */
+void tz_table::cover(time_t from, time_t to)
+{
+  if (spans.empty()) {
+    probe(from, to, spans);
+    end_ = to;
+    hint = 0;
+    return;
+  }
+  if (from < spans.front().begin) {
+    std::vector<tz_span> head;
+    probe(from, spans.front().begin, head);
+    if (head.back().gmtoff == spans.front().gmtoff 
+	  && head.back().isdst == spans.front().isdst) {
+      spans.front().begin = head.back().begin;
+      head.pop_back();
+    }
+    spans.insert(spans.begin(), head.begin(), head.end());
+    hint = 0;
+  }
+  if (to > end_) {
+    std::vector<tz_span> tail;
+    probe(end_, to, tail);
+    if (tail.front().gmtoff == spans.back().gmtoff 
+	  && tail.front().isdst == spans.back().isdst)
+      tail.erase(tail.begin());
+    spans.insert(spans.end(), tail.begin(), tail.end());
+    end_ = to;
+  }
+}
+
+void tz_table::clear()
+{
+  spans.clear();
+  end_ = 0;
+  hint = 0;
+}
+
+/**
+ * end of span @a i, the begin of the next one
+ */
+time_t tz_table::end(size_t i) const
+{
+  return i + 1 < spans.size() ? spans[i + 1].begin : end_;
+}
+
+/**
+ * index of the span containing @a t
+ *
+ * consecutive lookups mostly hit the same or the next span.
+ */
+size_t tz_table::index(time_t t)
+{
+  if (spans.empty() || t < spans.front().begin || t >= end_)
+    cover(std::min(t, spans.empty() ? t : spans.front().begin) - year, 
+	  std::max(t, end_) + year);
+
+  if (spans[hint].begin <= t && t < end(hint))
+    return hint;
+  if (hint + 1 < spans.size() && spans[hint + 1].begin <= t 
+	&& t < end(hint + 1))
+    return ++hint;
+
+  hint = std::upper_bound(spans.begin(), spans.end(), t, begins_after) 
+    - spans.begin() - 1;
+  return hint;
+}
+
+/**
+ * localtime of @a t as seconds since the epoch
+ */
+time_t tz_table::local(time_t t)
+{
+  return t + spans[index(t)].gmtoff;
+}
+
+/**
+ * UTC of localtime @a local
+ *
+ * Ambiguous times map to the first occurrence, times skipped by a
+ * transition are taken with the offset before the transition like
+ * mktime does.
+ */
+time_t tz_table::utc(time_t local)
+{
+  // offsets are less than a day, make sure the neighbours are there
+  index(local - 2*day);
+  index(local + 2*day);
+
+  size_t i = index(local - spans[index(local)].gmtoff);
+  if (i > 0) --i;
+  time_t t = local - spans[i].gmtoff;
+  for(; i < spans.size(); ++i) {
+    const time_t u = local - spans[i].gmtoff;
+    if (u < spans[i].begin) 
+      return t;			// in the gap before span i
+    if (u < end(i))
+      return u;
+    t = u;
+  }
+  return t;
+}
+
 void time_iterator::set(time_t start, time_t st, it_type ty)
 {
   step = st;
@@ -27,91 +249,123 @@ void time_iterator::set(time_t start, time_t st, it_type ty)
 
   type = ty;
 
+  tz_table &cache = local_zone();
+  cache.cover(start - year, std::max(start, time(0)) + year);
+  zone = cache;
+
   switch(type) {
-  case seconds: {
-    tzset();
-    localtime_r(&start, &now_tm);
-    now_t = ((start + now_tm.tm_gmtoff + step) / step) * step - now_tm.tm_gmtoff;
-    break; }
-  case weeks:
-    tzset();
-    localtime_r(&start, &now_tm);
-    step *= 3600*24*7;
-    now_tm.tm_sec = now_tm.tm_min = now_tm.tm_hour = 0;
-    now_tm.tm_mday -= now_tm.tm_wday - (now_tm.tm_wday == 0 ? 1 : 8);
-    now_t = mktime(&now_tm);
+  case seconds:
+    now_t = tick_after(start);
     break;
+  case weeks: {
+    // next monday
+    step *= week;
+    const time_t d = local_day(start);
+    const time_t wday = d + 4 - floor_div(d + 4, 7) * 7;
+    now_t = zone.utc((d + (wday == 0 ? 1 : 8 - wday)) * day);
+    break; }
   case month:
-    tzset();
-    localtime_r(&start, &now_tm);
-    now_tm.tm_sec = now_tm.tm_min = now_tm.tm_hour = 0;
-    if (now_tm.tm_mon == 11) {
-      now_tm.tm_mon = 0;
-      ++now_tm.tm_year;
-    } else {
-      ++now_tm.tm_mon;
-    }
-    now_tm.tm_mday = 1;
-    now_t = mktime(&now_tm);
+    now_t = first_of_month(local_month(start) + 1);
     break;
   case years:
-    tzset();
-    localtime_r(&start, &now_tm);
-    now_tm.tm_sec = now_tm.tm_min = now_tm.tm_hour = 0;
-    now_tm.tm_mon = 0;
-    now_tm.tm_mday = 1;
-    ++now_tm.tm_year;
-    now_tm.tm_isdst = 0;
-    now_t = mktime(&now_tm);
+    now_t = first_of_month((floor_div(local_month(start), 12) + 1) * 12);
     break;
   }
 }
 
+/**
+ * first tick after @a t, aligned to localtime
+ */
+time_t time_iterator::tick_after(time_t t)
+{
+  ++t;
+  for(;;) {
+    const size_t i = zone.index(t);
+    const time_t off = zone[i].gmtoff;
+    const time_t next = -floor_div(-(t + off), step) * step - off;
+    if (next < zone.end(i)) 
+      return next;
+    t = zone.end(i);
+  }
+}
+
+/**
+ * last tick before @a t, aligned to localtime
+ */
+time_t time_iterator::tick_before(time_t t)
+{
+  --t;
+  for(;;) {
+    const size_t i = zone.index(t);
+    const time_t off = zone[i].gmtoff;
+    const time_t prev = floor_div(t + off, step) * step - off;
+    if (prev >= zone[i].begin) 
+      return prev;
+    t = zone[i].begin - 1;
+  }
+}
+
+/**
+ * local day of @a t in days since 1970-01-01
+ */
+time_t time_iterator::local_day(time_t t)
+{
+  return floor_div(zone.local(t), day);
+}
+
+/**
+ * local month of @a t in months since year 0
+ */
+time_t time_iterator::local_month(time_t t)
+{
+  time_t y;
+  int m, d;
+  civil_from_days(local_day(t), y, m, d);
+  return y * 12 + m - 1;
+}
+
+/**
+ * start of the first day of @a month, months since year 0
+ */
+time_t time_iterator::first_of_month(time_t month)
+{
+  const time_t y = floor_div(month, 12);
+  return zone.utc(days_from_civil(y, month - y * 12 + 1, 1) * day);
+}
 
 time_iterator &time_iterator::operator++()
 {
   switch(type) {
   case seconds:
+    now_t = tick_after(now_t);
+    break;
   case weeks:
-    now_t += step;
+    now_t = zone.utc((local_day(now_t) + step / day) * day);
     break;
   case month:
-    // max step is 12!
-    now_tm.tm_mon += step;
-    if (now_tm.tm_mon >= 12) {
-      now_tm.tm_mon -= 12;
-      ++now_tm.tm_year;
-    }
-    now_t = mktime(&now_tm);
+    now_t = first_of_month(local_month(now_t) + step);
     break;
   case years:
-    now_tm.tm_year += step;
-    now_t = mktime(&now_tm);
+    now_t = first_of_month(local_month(now_t) + step * 12);
     break;
   }
   return *this;
 }
 
-
 time_iterator &time_iterator::operator--()
 {
   switch(type) {
   case seconds:
+    now_t = tick_before(now_t);
+    break;
   case weeks:
-    now_t -= step;
+    now_t = zone.utc((local_day(now_t) - step / day) * day);
     break;
   case month:
-    // max step is 12!
-    now_tm.tm_mon -= step;
-    if (now_tm.tm_mon < 1) {
-      now_tm.tm_mon += 12;
-      --now_tm.tm_year;
-    }
-    now_t = mktime(&now_tm);
+    now_t = first_of_month(local_month(now_t) - step);
     break;
   case years:
-    now_tm.tm_year -= step;
-    now_t = mktime(&now_tm);
+    now_t = first_of_month(local_month(now_t) - step * 12);
     break;
   }
   return *this;
@@ -133,16 +387,11 @@ time_t time_iterator::interval()
 
 const struct tm *time_iterator::tm()
 {
-  switch(type) {
-  case seconds:
-  case weeks:
-    tzset();
-    localtime_r(&now_t, &now_tm);
-    break;
-  case month:
-  case years:
-    break;
-  }
+  const tz_span &s = zone[zone.index(now_t)];
+  const time_t local = now_t + s.gmtoff;
+  gmtime_r(&local, &now_tm);
+  now_tm.tm_isdst = s.isdst;
+  now_tm.tm_gmtoff = s.gmtoff;
+  now_tm.tm_zone = s.zone;
   return &now_tm;
 }
-
@@ -26,7 +26,52 @@
 #include <sys/time.h>
 
 #include <iostream>
+#include <vector>
 
+/**
+ * UTC-offset of the local timezone between two transitions
+ */
+struct tz_span {
+  time_t begin;			// first second with this offset
+  long gmtoff;			// seconds east of UTC
+  int isdst;
+  const char *zone;		// abbreviation as given by localtime_r
+};
+
+/**
+ * transitions of the local timezone over a range of time
+ *
+ * The table is probed from libc once, after that conversions between
+ * UTC and localtime are integer-arithmetic only. The range grows when
+ * a lookup falls outside of it. Transitions less than a week apart
+ * are not resolved.
+ */
+class tz_table {
+ public:
+  tz_table() : end_(0), hint(0) { }
+
+  void cover(time_t from, time_t to);
+  void clear();
+
+  size_t index(time_t t);
+  const tz_span &operator[](size_t i) const { return spans[i]; }
+  time_t end(size_t i) const;
+
+  time_t local(time_t t);
+  time_t utc(time_t local);
+
+ private:
+  std::vector<tz_span> spans;
+  time_t end_;			// end of the probed range
+  size_t hint;			// index of the last lookup
+};
+
+/**
+ * iterator over the ticks of a time-axis aligned to localtime
+ *
+ * set() is not reentrant, copies of an iterator can be used in any
+ * thread.
+ */
 class time_iterator {
  public:  
   enum it_type { seconds, weeks, month, years };
@@ -45,12 +90,18 @@ class time_iterator {
   const struct tm *tm();
 
  protected:
+  time_t tick_after(time_t t);
+  time_t tick_before(time_t t);
+  time_t local_day(time_t t);
+  time_t local_month(time_t t);
+  time_t first_of_month(time_t month);
+
   it_type type;
   time_t now_t;
   struct tm now_tm;
   time_t step;
+  tz_table zone;
 };
-
 inline time_iterator::time_iterator(time_t start, time_t step, it_type type)
 {
   set(start, step, type);
@@ -0,0 +1,178 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "misc.h"
+#include "trace.h"
+
+namespace {
+
+struct trace_event {
+  const char *name;
+  const char *cat;
+  double ts, dur;		// µs since start of trace
+  std::string args;		// preformatted json-members
+};
+
+struct trace_buffer {
+  int tid;
+  std::vector<trace_event> events;
+};
+
+}
+
+QAtomicInt Tracer::enabled_(0);
+
+static std::string trace_file;
+static double trace_started;
+
+// all buffers ever created, guarded by registry_lock
+static QMutex registry_lock;
+static std::vector<trace_buffer *> registry;
+
+// buffer of the current thread
+static __thread trace_buffer *local_buffer = 0;
+
+/**
+ * append @a s to @a out as json-string
+ */
+static void json_string(std::string &out, const char *s)
+{
+  out += '"';
+  for(; *s; ++s) {
+    switch(*s) {
+    case '"':  out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if ((unsigned char)*s < 0x20) {
+	char buffer[8];
+	snprintf(buffer, sizeof(buffer), "\\u%04x", *s);
+	out += buffer;
+      } else {
+	out += *s;
+      }
+    }
+  }
+  out += '"';
+}
+
+/**
+ * start tracing, the trace is written to @a filename by finish()
+ */
+void Tracer::start(const std::string &filename)
+{
+  trace_file = filename;
+  trace_started = monotonic_seconds();
+  enabled_.fetchAndStoreOrdered(1);
+}
+
+void Tracer::add(const char *name, const char *cat, double started,
+      const std::string &args)
+{
+  if (!local_buffer) {
+    QMutexLocker locker(&registry_lock);
+    local_buffer = new trace_buffer;
+    local_buffer->tid = registry.size() + 1;
+    registry.push_back(local_buffer);
+  }
+  trace_event e;
+  e.name = name;
+  e.cat = cat;
+  e.ts = (started - trace_started) * 1e6;
+  e.dur = (monotonic_seconds() - started) * 1e6;
+  e.args = args;
+  local_buffer->events.push_back(e);
+}
+
+/**
+ * stop tracing and write all buffers as json
+ *
+ * must not be called while other threads are still tracing.
+ */
+bool Tracer::finish()
+{
+  if (!enabled_.testAndSetOrdered(1, 0)) return true;
+
+  FILE *out = fopen(trace_file.c_str(), "w");
+  if (!out) return false;
+
+  QMutexLocker locker(&registry_lock);
+  const int pid = getpid();
+  const char *sep = "";
+  fprintf(out, "{\"traceEvents\":[\n");
+  for(std::vector<trace_buffer *>::iterator b = registry.begin();
+      b != registry.end(); ++b) {
+    fprintf(out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+	  "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", sep, pid, (*b)->tid,
+	  (*b)->tid == 1 ? "main" : "worker");
+    sep = ",\n";
+    for(std::vector<trace_event>::iterator e = (*b)->events.begin();
+	e != (*b)->events.end(); ++e) {
+      std::string name;
+      json_string(name, e->name);
+      fprintf(out, "%s{\"ph\":\"X\",\"name\":%s,\"cat\":\"%s\",\"pid\":%d,"
+	    "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{%s}}", sep, 
+	    name.c_str(), e->cat, pid, (*b)->tid, e->ts, e->dur, 
+	    e->args.c_str());
+    }
+    (*b)->events.clear();
+  }
+  fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return fclose(out) == 0;
+}
+
+TraceSpan::TraceSpan(const char *n, const char *c)
+  : name(n), cat(c), started(Tracer::enabled() ? monotonic_seconds() : -1)
+{
+}
+
+TraceSpan::TraceSpan(const char *n, const char *c, 
+      const char *key1, const char *value1,
+      const char *key2, const char *value2)
+  : name(n), cat(c), started(Tracer::enabled() ? monotonic_seconds() : -1)
+{
+  if (started < 0) return;
+
+  json_string(args, key1);
+  args += ':';
+  json_string(args, value1);
+  if (key2) {
+    args += ',';
+    json_string(args, key2);
+    args += ':';
+    json_string(args, value2);
+  }
+}
+
+TraceSpan::~TraceSpan()
+{
+  if (started >= 0 && Tracer::enabled())
+    Tracer::add(name, cat, started, args);
+}
@@ -0,0 +1,67 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+#include <QAtomicInt>
+
+/**
+ * opt-in recorder of spans in Chrome trace-event format
+ *
+ * Every thread appends to its own buffer, the buffers are only merged
+ * when the trace is written. As long as tracing is not started a
+ * TraceSpan costs a test of a flag.
+ */
+class Tracer {
+public:
+  static void start(const std::string &filename);
+  static bool finish();
+  static bool enabled() { return enabled_ != 0; }
+
+private:
+  friend class TraceSpan;
+  static void add(const char *name, const char *cat, double started,
+	const std::string &args);
+
+  static QAtomicInt enabled_;	// read on the worker-threads
+};
+
+/**
+ * records its lifetime as a complete-event ("ph":"X")
+ */
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name, const char *cat = "kcollectd");
+  TraceSpan(const char *name, const char *cat, 
+	const char *key1, const char *value1,
+	const char *key2 = 0, const char *value2 = 0);
+  ~TraceSpan();
+
+private:
+  const char *name, *cat;
+  double started;
+  std::string args;
+};
+
+#endif
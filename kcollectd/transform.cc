@@ -0,0 +1,164 @@
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "transform.h"
+
+/**
+ * out = t + m * in for a whole series, NaN stays NaN
+ *
+ * free of branches, so the compiler can vectorize it
+ */
+static void affine(const double *in, int n, double m, double t, float *out)
+{
+  for(int i=0; i<n; ++i)
+    out[i] = t + m * in[i];
+}
+
+/**
+ * mapping of values to y, min to the bottom and max to the top of a
+ * panel with @a height pixels
+ */
+static void y_mapping(int height, double min, double max, double *m, double *t)
+{
+  *m = (1.0 - height) / (max - min);
+  *t = height - 0.5 - *m * min;
+}
+
+/**
+ * map the samples of @a data into the panel
+ */
+void map_line(const std::vector<double> &data, unsigned long generation,
+      int width, int height, double min, double max, screen_series *s)
+{
+  const int n = data.size();
+  double m, t;
+  y_mapping(height, min, max, &m, &t);
+
+  const bool same_x = 
+    s->generation == generation && s->size == n && s->width == width;
+  if (same_x && s->height == height && s->min == min && s->max == max)
+    return;
+  if (same_x) {
+    // only the y-range changed
+    for(int k=0; k<s->count(); ++k)
+      affine(&data[s->first[k]], s->runs[k+1] - s->runs[k], m, t, 
+	    &s->lo[s->runs[k]]);
+  } else {
+    const float xm = n > 1 ? (width - 1.0f) / (n - 1) : 0;
+    s->scratch.resize(n);
+    if (n)
+      affine(&data[0], n, m, t, &s->scratch[0]);
+
+    // compact the valid samples and note where runs start
+    s->x.clear();
+    s->lo.clear();
+    s->runs.clear();
+    s->first.clear();
+    bool in_run = false;
+    for(int i=0; i<n; ++i) {
+      const float y = s->scratch[i];
+      if (y != y) {
+	in_run = false;
+	continue;
+      }
+      if (!in_run) {
+	s->runs.push_back(s->x.size());
+	s->first.push_back(i);
+	in_run = true;
+      }
+      s->x.push_back(0.5f + xm * i);
+      s->lo.push_back(y);
+    }
+    s->runs.push_back(s->x.size());
+  }
+
+  s->generation = generation;
+  s->size = n;
+  s->width = width;
+  s->height = height;
+  s->min = min;
+  s->max = max;
+}
+
+/**
+ * map the samples of a band into the panel, runs end where @a lo or
+ * @a hi is NaN
+ */
+void map_band(const std::vector<double> &lo, const std::vector<double> &hi,
+      unsigned long generation, int width, int height, double min, 
+      double max, screen_series *s)
+{
+  const int n = std::min(lo.size(), hi.size());
+  double m, t;
+  y_mapping(height, min, max, &m, &t);
+
+  const bool same_x = 
+    s->generation == generation && s->size == n && s->width == width;
+  if (same_x && s->height == height && s->min == min && s->max == max)
+    return;
+  if (same_x) {
+    // only the y-range changed
+    for(int k=0; k<s->count(); ++k) {
+      const int count = s->runs[k+1] - s->runs[k];
+      affine(&lo[s->first[k]], count, m, t, &s->lo[s->runs[k]]);
+      affine(&hi[s->first[k]], count, m, t, &s->hi[s->runs[k]]);
+    }
+  } else {
+    const float xm = n > 1 ? (width - 1.0f) / (n - 1) : 0;
+    s->scratch.resize(2 * n);
+    if (n) {
+      affine(&lo[0], n, m, t, &s->scratch[0]);
+      affine(&hi[0], n, m, t, &s->scratch[n]);
+    }
+
+    s->x.clear();
+    s->lo.clear();
+    s->hi.clear();
+    s->runs.clear();
+    s->first.clear();
+    bool in_run = false;
+    for(int i=0; i<n; ++i) {
+      const float y0 = s->scratch[i], y1 = s->scratch[n + i];
+      if (y0 != y0 || y1 != y1) {
+	in_run = false;
+	continue;
+      }
+      if (!in_run) {
+	s->runs.push_back(s->x.size());
+	s->first.push_back(i);
+	in_run = true;
+      }
+      s->x.push_back(0.5f + xm * i);
+      s->lo.push_back(y0);
+      s->hi.push_back(y1);
+    }
+    s->runs.push_back(s->x.size());
+  }
+
+  s->generation = generation;
+  s->size = n;
+  s->width = width;
+  s->height = height;
+  s->min = min;
+  s->max = max;
+}
@@ -0,0 +1,60 @@
+/* -*- c++ -*- */
+/*
+ * This file is part of the source of kcollectd, a viewer for
+ * rrd-databases created by collectd
+ *
+ * Copyright (C) 2008 M G Berberich
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <vector>
+
+/**
+ * a series mapped to the pixels of a panel, split into runs at NaN
+ *
+ * the valid samples are stored back to back, run k is
+ * [runs[k], runs[k+1]). Coordinates are continuous pixels relative to
+ * the panel as the Rasterizer takes them, hi is only used by bands.
+ * The buffers are kept between repaints: if nothing changed the
+ * mapping is skipped, if only height or y-range changed x and the
+ * runs are kept.
+ */
+struct screen_series {
+  std::vector<float> x, lo, hi;
+  std::vector<int> runs;
+  std::vector<int> first;	// data-index of the first sample of each run
+  std::vector<float> scratch;
+
+  // what the coordinates were made from
+  unsigned long generation;
+  int size, width, height;
+  double min, max;
+
+  screen_series() : generation(0), size(-1), width(0), height(0), 
+		    min(0), max(0) { }
+  int count() const { return runs.empty() ? 0 : runs.size() - 1; }
+};
+
+void map_line(const std::vector<double> &data, unsigned long generation,
+      int width, int height, double min, double max, screen_series *s);
+
+void map_band(const std::vector<double> &lo, const std::vector<double> &hi,
+      unsigned long generation, int width, int height, double min, 
+      double max, screen_series *s);
+
+#endif